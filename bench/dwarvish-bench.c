@@ -0,0 +1,398 @@
+/*
+ * Headless benchmark of loading and browsing a file's DWARF.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <dwarf.h>
+
+#include "attrtree.h"
+#include "dietree.h"
+#include "dietreemodel.h"
+#include "dwstring.h"
+#include "session.h"
+
+
+/* Each phase does what the views would for a user who opens the file,
+ * scrolls the top level, expands everything, follows type references and
+ * reads every attribute, through the same loader, model and attribute
+ * store as the views, but without a display.  Whatever the views leave to
+ * the main loop is waited for by running it here.  Each phase of each sample is reported as a line of JSON, with
+ * the peak RSS so far, so results can be appended to a log and compared
+ * across builds.  */
+#define BENCH_MAX_REFS 10000
+
+typedef struct _Bench
+{
+  const gchar *file;
+  const gchar *label;
+  const gchar *build;
+  guint sample;
+
+  DwarvishSession *session;
+  DieTreeModel *models[2];      /* For .debug_info and .debug_types.  */
+  GArray *refs[2];              /* Dwarf_Die, targets of DW_AT_type.  */
+  gboolean loaded;              /* Set by "children-loaded".  */
+
+  GTimer *timer;
+} Bench;
+
+
+static void
+bench_json_string (GString *out, const char *str)
+{
+  g_string_append_c (out, '"');
+  for (const unsigned char *s = (const unsigned char *) str; *s; ++s)
+    if (*s == '"' || *s == '\\')
+      g_string_append_printf (out, "\\%c", *s);
+    else if (*s < 0x20)
+      g_string_append_printf (out, "\\u%04x", *s);
+    else
+      g_string_append_c (out, *s);
+  g_string_append_c (out, '"');
+}
+
+
+static void
+bench_report (Bench *bench, const char *phase, guint64 items)
+{
+  gdouble seconds = g_timer_elapsed (bench->timer, NULL);
+
+  struct rusage usage;
+  long maxrss = getrusage (RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+
+  GString *out = g_string_new ("{\"bench\":");
+  bench_json_string (out, phase);
+  g_string_append (out, ",\"label\":");
+  bench_json_string (out, bench->label);
+  g_string_append (out, ",\"build\":");
+  bench_json_string (out, bench->build);
+  g_string_append (out, ",\"file\":");
+  bench_json_string (out, bench->file);
+  g_string_append_printf (out, ",\"sample\":%u,\"seconds\":%.6f,"
+                          "\"items\":%" G_GUINT64_FORMAT
+                          ",\"maxrss_kb\":%ld}\n",
+                          bench->sample, seconds, items, maxrss);
+  fputs (out->str, stdout);
+  fflush (stdout);
+  g_string_free (out, TRUE);
+
+  g_timer_start (bench->timer);
+}
+
+
+/* Run the main loop until a condition is met, which only the main loop's
+ * own sources could still bring about.  */
+static void
+bench_iterate (gboolean (*done) (gpointer), gpointer data)
+{
+  while (!done (data))
+    g_main_context_iteration (NULL, TRUE);
+}
+
+
+static gboolean
+bench_units_loaded (gpointer data)
+{
+  return !die_tree_units_loading (data);
+}
+
+
+/* List every unit in a new model with the views' loader.  */
+static DieTreeModel *
+bench_list_units (Bench *bench, gboolean types)
+{
+  DieTreeModel *model = die_tree_load_units (bench->session, types, NULL);
+  bench_iterate (bench_units_loaded, model);
+  return model;
+}
+
+
+/* Get the columns of a row as the view's cells would render them.  */
+static void
+bench_render_row (GtkTreeModel *model, GtkTreeIter *iter)
+{
+  guint64 offset;
+  gint tag;
+  gchar *name;
+  gtk_tree_model_get (model, iter, DIE_TREE_COL_OFFSET, &offset,
+                      DIE_TREE_COL_TAG, &tag, DIE_TREE_COL_NAME, &name, -1);
+
+  char text[32];
+  g_snprintf (text, sizeof text, "%" G_GINT64_MODIFIER "x", offset);
+  (void) DW_TAG__name (tag);
+  g_free (name);
+}
+
+
+static guint64
+bench_render_top (GtkTreeModel *model)
+{
+  guint64 count = 0;
+  GtkTreeIter iter;
+  if (gtk_tree_model_get_iter_first (model, &iter))
+    do
+      {
+        bench_render_row (model, &iter);
+        ++count;
+      }
+    while (gtk_tree_model_iter_next (model, &iter));
+  return count;
+}
+
+
+static void
+signal_bench_children_loaded (G_GNUC_UNUSED DieTreeModel *model,
+                              G_GNUC_UNUSED GtkTreePath *path,
+                              gpointer user_data)
+{
+  ((Bench *) user_data)->loaded = TRUE;
+}
+
+
+typedef struct _BenchExpand
+{
+  Bench *bench;
+  GtkTreeModel *model;
+  GtkTreeIter *iter;
+} BenchExpand;
+
+
+/* A background fill ends with "children-loaded", or with no rows.  */
+static gboolean
+bench_children_loaded (gpointer data)
+{
+  BenchExpand *expand = data;
+  return (expand->bench->loaded
+          || !gtk_tree_model_iter_has_child (expand->model, expand->iter));
+}
+
+
+/* Expand a row as the view does when it's opened, waiting for any
+ * children it left to the background.  */
+static void
+bench_expand_row (Bench *bench, DieTreeModel *model, GtkTreeIter *iter)
+{
+  BenchExpand expand = { bench, GTK_TREE_MODEL (model), iter };
+  bench->loaded = FALSE;
+  GtkTreeIter child;
+  Dwarf_Die die;
+  if (die_tree_model_expand (model, iter)
+      && gtk_tree_model_iter_children (expand.model, &child, iter)
+      && !die_tree_model_get_die (model, &child, &die))
+    bench_iterate (bench_children_loaded, &expand);
+}
+
+
+/* Render all the rows below this one, remembering some type references
+ * to navigate later.  */
+static guint64
+bench_expand_children (Bench *bench, gboolean types, GtkTreeIter *parent)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (bench->models[types]);
+  GArray *refs = bench->refs[types];
+
+  guint64 count = 0;
+  GtkTreeIter iter;
+  if (gtk_tree_model_iter_children (model, &iter, parent))
+    do
+      {
+        bench_render_row (model, &iter);
+        ++count;
+
+        Dwarf_Die die, ref;
+        Dwarf_Attribute attr;
+        if (refs->len < BENCH_MAX_REFS
+            && die_tree_model_get_die (bench->models[types], &iter, &die)
+            && dwarf_attr (&die, DW_AT_type, &attr) != NULL
+            && dwarf_whatform (&attr) != DW_FORM_ref_sig8
+            && dwarf_formref_die (&attr, &ref) != NULL)
+          g_array_append_val (refs, ref);
+
+        bench_expand_row (bench, bench->models[types], &iter);
+        count += bench_expand_children (bench, types, &iter);
+      }
+    while (gtk_tree_model_iter_next (model, &iter));
+  return count;
+}
+
+
+/* Find the references in fresh models, so every lookup has to expand the
+ * target's ancestors, as when following a link in the attr view.  */
+static guint64
+bench_navigate (Bench *bench, gboolean types)
+{
+  GArray *refs = bench->refs[types];
+  if (refs->len == 0)
+    return 0;
+
+  DieTreeModel *model = bench_list_units (bench, types);
+
+  guint64 count = 0;
+  for (guint i = 0; i < refs->len; ++i)
+    {
+      GtkTreePath *path =
+        die_tree_model_find_die (model, &g_array_index (refs, Dwarf_Die, i),
+                                 NULL);
+      if (path != NULL)
+        {
+          ++count;
+          gtk_tree_path_free (path);
+        }
+    }
+
+  g_object_unref (model);
+  return count;
+}
+
+
+/* Render the attributes of every row already expanded, with each in a
+ * store of its own as if it were selected.  */
+static guint64
+bench_render_attrs (Bench *bench, gboolean types, GtkTreeIter *parent)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (bench->models[types]);
+
+  guint64 count = 0;
+  GtkTreeIter iter;
+  if (gtk_tree_model_iter_children (model, &iter, parent))
+    do
+      {
+        Dwarf_Die die;
+        if (die_tree_model_get_die (bench->models[types], &iter, &die))
+          {
+            g_object_unref (attr_tree_model_new (bench->session, &die));
+            ++count;
+          }
+        count += bench_render_attrs (bench, types, &iter);
+      }
+    while (gtk_tree_model_iter_next (model, &iter));
+  return count;
+}
+
+
+static gboolean
+bench_sample (Bench *bench)
+{
+  g_timer_start (bench->timer);
+
+  bench->session = session_begin ();
+  bench->session->file = g_strdup (bench->file);
+  const char *error = session_init_dwarf (bench->session);
+  if (error != NULL)
+    {
+      g_printerr ("%s: %s\n", bench->file, error);
+      session_end (bench->session);
+      return FALSE;
+    }
+  bench_report (bench, "load", 1);
+
+  guint64 count = 0;
+  for (gboolean types = FALSE; types <= TRUE; ++types)
+    {
+      bench->models[types] = bench_list_units (bench, types);
+      g_signal_connect (bench->models[types], "children-loaded",
+                        G_CALLBACK (signal_bench_children_loaded), bench);
+      bench->refs[types] = g_array_new (FALSE, FALSE, sizeof (Dwarf_Die));
+      count += bench_render_top (GTK_TREE_MODEL (bench->models[types]));
+    }
+  bench_report (bench, "units", count);
+
+  count = 0;
+  for (gboolean types = FALSE; types <= TRUE; ++types)
+    count += bench_expand_children (bench, types, NULL);
+  bench_report (bench, "expand", count);
+
+  count = 0;
+  for (gboolean types = FALSE; types <= TRUE; ++types)
+    count += bench_navigate (bench, types);
+  bench_report (bench, "refs", count);
+
+  count = 0;
+  for (gboolean types = FALSE; types <= TRUE; ++types)
+    count += bench_render_attrs (bench, types, NULL);
+  bench_report (bench, "attrs", count);
+
+  for (gboolean types = FALSE; types <= TRUE; ++types)
+    {
+      g_object_unref (bench->models[types]);
+      g_array_free (bench->refs[types], TRUE);
+    }
+  session_end (bench->session);
+  bench->session = NULL;
+  return TRUE;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  gchar *label = NULL;
+  gchar *build = NULL;
+  gint samples = 1;
+  GError *error = NULL;
+  GOptionEntry options[] =
+    {
+        {
+          "label", 'l', 0, G_OPTION_ARG_STRING, &label,
+          "Name the input in the results", "NAME"
+        },
+        {
+          "build", 'b', 0, G_OPTION_ARG_STRING, &build,
+          "Name the build in the results", "ID"
+        },
+        {
+          "samples", 'n', 0, G_OPTION_ARG_INT, &samples,
+          "Number of times to run each phase", "N"
+        },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+
+  g_type_init ();
+
+  GOptionContext *context = g_option_context_new ("FILE - benchmark dwarvish");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  if (argc != 2 || samples < 1)
+    {
+      g_printerr ("A single FILE and a positive sample count are required.\n");
+      return EXIT_FAILURE;
+    }
+
+  Bench bench;
+  memset (&bench, 0, sizeof bench);
+  bench.file = argv[1];
+  bench.label = label ?: argv[1];
+  bench.build = build ?: "";
+  bench.timer = g_timer_new ();
+
+  gboolean ok = TRUE;
+  for (; ok && bench.sample < (guint) samples; ++bench.sample)
+    ok = bench_sample (&bench);
+
+  g_timer_destroy (bench.timer);
+  g_free (label);
+  g_free (build);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,155 @@
+/*
+ * Micro-benchmark for the DWARF name lookups.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dwarf.h>
+#include "dwstring.h"
+
+
+/* Each "row" names a DIE's tag, and then the attribute and form of each of
+ * its attributes, as a tree row and its attribute pane would.  The last
+ * codes are not known to dwarf.h, to exercise the hex fallback too.  */
+static const int tags[] =
+{
+  DW_TAG_compile_unit, DW_TAG_subprogram, DW_TAG_variable,
+  DW_TAG_formal_parameter, DW_TAG_member, DW_TAG_base_type,
+  DW_TAG_pointer_type, DW_TAG_typedef, 0x4fff,
+};
+
+static const int attrs[][2] =
+{
+  { DW_AT_name, DW_FORM_strp },
+  { DW_AT_decl_file, DW_FORM_data1 },
+  { DW_AT_decl_line, DW_FORM_data2 },
+  { DW_AT_type, DW_FORM_ref4 },
+  { DW_AT_location, DW_FORM_exprloc },
+  { DW_AT_external, DW_FORM_flag_present },
+  { 0x3fff, 0x7f },
+};
+
+#define BENCH_ROWS 1000000
+
+
+/* GLib has ignored g_mem_set_vtable since 2.46, so allocations are counted
+ * by interposing malloc itself, passing each call on to glibc's own.  Where
+ * that isn't possible the count never moves, and main refuses to report.  */
+static volatile gsize allocations;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc (size_t n);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *mem, size_t n);
+
+void *
+malloc (size_t n)
+{
+  ++allocations;
+  return __libc_malloc (n);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  ++allocations;
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *mem, size_t n)
+{
+  ++allocations;
+  return __libc_realloc (mem, n);
+}
+#endif
+
+
+static gsize
+bench_strdup_hex (guint row)
+{
+  gsize len = 0;
+  char *s = DW_TAG__strdup_hex (tags[row % G_N_ELEMENTS (tags)]);
+  len += *s;
+  g_free (s);
+  for (guint i = 0; i < G_N_ELEMENTS (attrs); ++i)
+    {
+      s = DW_AT__strdup_hex (attrs[i][0]);
+      len += *s;
+      g_free (s);
+      s = DW_FORM__strdup_hex (attrs[i][1]);
+      len += *s;
+      g_free (s);
+    }
+  return len;
+}
+
+
+static gsize
+bench_name (guint row)
+{
+  gsize len = *DW_TAG__name (tags[row % G_N_ELEMENTS (tags)]);
+  for (guint i = 0; i < G_N_ELEMENTS (attrs); ++i)
+    len += *DW_AT__name (attrs[i][0]) + *DW_FORM__name (attrs[i][1]);
+  return len;
+}
+
+
+/* Results are reported as lines of JSON, like dwarvish-bench's.  */
+static void
+bench_run (const char *label, const char *build, gsize (*fn) (guint))
+{
+  /* Warm up first, so interned names are not counted.  */
+  gsize sum = fn (G_N_ELEMENTS (tags) - 1);
+
+  GTimer *timer = g_timer_new ();
+  gsize before = allocations;
+  g_timer_start (timer);
+  for (guint row = 0; row < BENCH_ROWS; ++row)
+    sum += fn (row);
+  gdouble elapsed = g_timer_elapsed (timer, NULL);
+  gsize count = allocations - before;
+  g_timer_destroy (timer);
+
+  printf ("{\"bench\":\"%s\",\"build\":\"%s\",\"rows\":%u,"
+          "\"seconds\":%.6f,\"allocs_per_row\":%.3f,\"ns_per_row\":%.1f,"
+          "\"checksum\":%" G_GSIZE_FORMAT "}\n",
+          label, build, BENCH_ROWS, elapsed, (gdouble) count / BENCH_ROWS,
+          elapsed * 1e9 / BENCH_ROWS, sum);
+}
+
+
+/* The only argument is an optional build ID, which is trusted to need no
+ * escaping.  */
+int
+main (int argc, char **argv)
+{
+  const char *build = argc > 1 ? argv[1] : "";
+
+  /* Check that allocations through GLib are seen at all, rather than
+   * reporting none for every run.  */
+  gsize before = allocations;
+  g_free (g_malloc (1));
+  if (allocations == before)
+    {
+      fprintf (stderr, "dwstring-bench: can't count allocations here\n");
+      return EXIT_FAILURE;
+    }
+
+  bench_run ("DW_*__strdup_hex", build, bench_strdup_hex);
+  bench_run ("DW_*__name", build, bench_name);
+  return 0;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,584 @@
+/*
+ * Synthetic DWARF generator for benchmarks.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dwarf.h>
+#include <glib.h>
+
+
+/* This writes a relocatable ELF object with DWARF 4 that looks enough like
+ * a compiler's to exercise every view: compile units full of functions,
+ * chains of nested struct types, dwz-style partial units imported by the
+ * compile units, and type units referenced by signature.  Everything is in
+ * host byte order, and nothing needs relocating.  */
+
+#if defined (__x86_64__)
+# define GEN_MACHINE EM_X86_64
+#elif defined (__aarch64__)
+# define GEN_MACHINE EM_AARCH64
+#else
+# define GEN_MACHINE EM_NONE
+#endif
+
+#define GEN_FUNCTION_SIZE 16
+
+enum
+{
+  ABBREV_COMPILE_UNIT = 1,
+  ABBREV_PARTIAL_UNIT,
+  ABBREV_TYPE_UNIT,
+  ABBREV_IMPORTED_UNIT,
+  ABBREV_BASE_TYPE,
+  ABBREV_POINTER_TYPE,
+  ABBREV_STRUCTURE_TYPE,
+  ABBREV_MEMBER,
+  ABBREV_TYPEDEF,
+  ABBREV_SUBPROGRAM,
+  ABBREV_FORMAL_PARAMETER,
+  ABBREV_VARIABLE,
+  ABBREV_VARIABLE_ALT,          /* With a ref_addr type.  */
+  ABBREV_VARIABLE_SIG,          /* With a ref_sig8 type.  */
+};
+
+static const guint abbrevs[][14] =
+{
+  { ABBREV_COMPILE_UNIT, DW_TAG_compile_unit, DW_CHILDREN_yes,
+    DW_AT_name, DW_FORM_strp, DW_AT_language, DW_FORM_data1,
+    DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_data4 },
+  { ABBREV_PARTIAL_UNIT, DW_TAG_partial_unit, DW_CHILDREN_yes,
+    DW_AT_language, DW_FORM_data1 },
+  { ABBREV_TYPE_UNIT, DW_TAG_type_unit, DW_CHILDREN_yes,
+    DW_AT_language, DW_FORM_data1 },
+  { ABBREV_IMPORTED_UNIT, DW_TAG_imported_unit, DW_CHILDREN_no,
+    DW_AT_import, DW_FORM_ref_addr },
+  { ABBREV_BASE_TYPE, DW_TAG_base_type, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_encoding, DW_FORM_data1,
+    DW_AT_byte_size, DW_FORM_data1 },
+  { ABBREV_POINTER_TYPE, DW_TAG_pointer_type, DW_CHILDREN_no,
+    DW_AT_byte_size, DW_FORM_data1, DW_AT_type, DW_FORM_ref4 },
+  { ABBREV_STRUCTURE_TYPE, DW_TAG_structure_type, DW_CHILDREN_yes,
+    DW_AT_name, DW_FORM_strp, DW_AT_byte_size, DW_FORM_data4 },
+  { ABBREV_MEMBER, DW_TAG_member, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_type, DW_FORM_ref4,
+    DW_AT_data_member_location, DW_FORM_data4 },
+  { ABBREV_TYPEDEF, DW_TAG_typedef, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_type, DW_FORM_ref4 },
+  { ABBREV_SUBPROGRAM, DW_TAG_subprogram, DW_CHILDREN_yes,
+    DW_AT_name, DW_FORM_strp, DW_AT_external, DW_FORM_flag_present,
+    DW_AT_type, DW_FORM_ref4, DW_AT_low_pc, DW_FORM_addr,
+    DW_AT_high_pc, DW_FORM_data4 },
+  { ABBREV_FORMAL_PARAMETER, DW_TAG_formal_parameter, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_type, DW_FORM_ref4 },
+  { ABBREV_VARIABLE, DW_TAG_variable, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_type, DW_FORM_ref4 },
+  { ABBREV_VARIABLE_ALT, DW_TAG_variable, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_type, DW_FORM_ref_addr },
+  { ABBREV_VARIABLE_SIG, DW_TAG_variable, DW_CHILDREN_no,
+    DW_AT_name, DW_FORM_strp, DW_AT_type, DW_FORM_ref_sig8 },
+};
+
+
+typedef struct _Gen
+{
+  /* Options.  */
+  gint units;
+  gint children;
+  gint type_depth;
+  gint partial_units;
+  gint type_units;
+
+  GByteArray *abbrev;
+  GByteArray *info;
+  GByteArray *types;
+  GByteArray *str;
+  GHashTable *strings;          /* Name -> offset + 1 in str.  */
+
+  GArray *partial_dies;         /* The .debug_info offset of each partial */
+  GArray *partial_structs;      /* unit, and of the struct it shares.  */
+  guint64 address;              /* Next function address.  */
+} Gen;
+
+
+static void
+put (GByteArray *buf, gconstpointer data, guint size)
+{
+  g_byte_array_append (buf, data, size);
+}
+
+static void
+put_u8 (GByteArray *buf, guint8 value)
+{
+  put (buf, &value, sizeof value);
+}
+
+static void
+put_u16 (GByteArray *buf, guint16 value)
+{
+  put (buf, &value, sizeof value);
+}
+
+static void
+put_u32 (GByteArray *buf, guint32 value)
+{
+  put (buf, &value, sizeof value);
+}
+
+static void
+put_u64 (GByteArray *buf, guint64 value)
+{
+  put (buf, &value, sizeof value);
+}
+
+static void
+put_uleb (GByteArray *buf, guint64 value)
+{
+  do
+    {
+      guint8 byte = value & 0x7f;
+      value >>= 7;
+      put_u8 (buf, byte | (value ? 0x80 : 0));
+    }
+  while (value);
+}
+
+static void
+patch_u32 (GByteArray *buf, guint offset, guint32 value)
+{
+  memcpy (buf->data + offset, &value, sizeof value);
+}
+
+
+static void
+put_strp (Gen *gen, GByteArray *buf, const char *name)
+{
+  gpointer found = g_hash_table_lookup (gen->strings, name);
+  guint32 offset = GPOINTER_TO_UINT (found) - 1;
+  if (found == NULL)
+    {
+      offset = gen->str->len;
+      put (gen->str, name, strlen (name) + 1);
+      g_hash_table_insert (gen->strings, g_strdup (name),
+                           GUINT_TO_POINTER (offset + 1));
+    }
+  put_u32 (buf, offset);
+}
+
+
+static void
+gen_abbrevs (Gen *gen)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (abbrevs); ++i)
+    {
+      const guint *abbrev = abbrevs[i];
+      put_uleb (gen->abbrev, abbrev[0]);
+      put_uleb (gen->abbrev, abbrev[1]);
+      put_u8 (gen->abbrev, abbrev[2]);
+      for (guint j = 3; j + 1 < G_N_ELEMENTS (abbrevs[i]) && abbrev[j];
+           j += 2)
+        {
+          put_uleb (gen->abbrev, abbrev[j]);
+          put_uleb (gen->abbrev, abbrev[j + 1]);
+        }
+      put_uleb (gen->abbrev, 0);
+      put_uleb (gen->abbrev, 0);
+    }
+  put_uleb (gen->abbrev, 0);
+}
+
+
+/* Start a unit, returning its offset for the length to be patched.  */
+static guint
+gen_unit_begin (GByteArray *buf)
+{
+  guint start = buf->len;
+  put_u32 (buf, 0);
+  put_u16 (buf, 4);
+  put_u32 (buf, 0);             /* All units share the abbrevs.  */
+  put_u8 (buf, sizeof (guint64));
+  return start;
+}
+
+static void
+gen_unit_end (GByteArray *buf, guint start)
+{
+  patch_u32 (buf, start, buf->len - start - 4);
+}
+
+
+/* A base type, which is always the first child of a unit.  */
+static guint32
+gen_base_type (Gen *gen, GByteArray *buf, guint start, const char *name)
+{
+  guint32 offset = buf->len - start;
+  put_uleb (buf, ABBREV_BASE_TYPE);
+  put_strp (gen, buf, name);
+  put_u8 (buf, DW_ATE_signed);
+  put_u8 (buf, 4);
+  return offset;
+}
+
+
+/* A struct with an int and a pointer to the previous struct in the chain,
+ * or another int if it's the first.  Returns the struct's offset.  */
+static guint32
+gen_struct (Gen *gen, GByteArray *buf, guint start, const char *name,
+            guint32 int_type, guint32 previous)
+{
+  guint32 next_type = int_type;
+  if (previous != 0)
+    {
+      next_type = buf->len - start;
+      put_uleb (buf, ABBREV_POINTER_TYPE);
+      put_u8 (buf, sizeof (guint64));
+      put_u32 (buf, previous);
+    }
+
+  guint32 offset = buf->len - start;
+  put_uleb (buf, ABBREV_STRUCTURE_TYPE);
+  put_strp (gen, buf, name);
+  put_u32 (buf, 16);
+
+  put_uleb (buf, ABBREV_MEMBER);
+  put_strp (gen, buf, "value");
+  put_u32 (buf, int_type);
+  put_u32 (buf, 0);
+
+  put_uleb (buf, ABBREV_MEMBER);
+  put_strp (gen, buf, "next");
+  put_u32 (buf, next_type);
+  put_u32 (buf, 8);
+
+  put_uleb (buf, 0);
+  return offset;
+}
+
+
+static void
+gen_partial_units (Gen *gen)
+{
+  gen->partial_dies = g_array_new (FALSE, FALSE, sizeof (guint32));
+  gen->partial_structs = g_array_new (FALSE, FALSE, sizeof (guint32));
+  for (gint i = 0; i < gen->partial_units; ++i)
+    {
+      guint start = gen_unit_begin (gen->info);
+      guint32 die = gen->info->len;
+      g_array_append_val (gen->partial_dies, die);
+      put_uleb (gen->info, ABBREV_PARTIAL_UNIT);
+      put_u8 (gen->info, DW_LANG_C99);
+
+      gchar *name = g_strdup_printf ("shared%d", i);
+      guint32 int_type = gen_base_type (gen, gen->info, start, "int");
+      guint32 offset = start + gen_struct (gen, gen->info, start, name,
+                                           int_type, 0);
+      g_array_append_val (gen->partial_structs, offset);
+      g_free (name);
+
+      put_uleb (gen->info, 0);
+      gen_unit_end (gen->info, start);
+    }
+}
+
+
+static guint64
+gen_type_signature (gint i)
+{
+  return 0x5157ULL << 48 | (guint64) i;
+}
+
+
+static void
+gen_type_units (Gen *gen)
+{
+  for (gint i = 0; i < gen->type_units; ++i)
+    {
+      guint start = gen_unit_begin (gen->types);
+      put_u64 (gen->types, gen_type_signature (i));
+      guint type_offset = gen->types->len;
+      put_u32 (gen->types, 0);
+
+      put_uleb (gen->types, ABBREV_TYPE_UNIT);
+      put_u8 (gen->types, DW_LANG_C99);
+
+      gchar *name = g_strdup_printf ("tu%d", i);
+      guint32 int_type = gen_base_type (gen, gen->types, start, "int");
+      guint32 offset = gen_struct (gen, gen->types, start, name, int_type, 0);
+      patch_u32 (gen->types, type_offset, offset);
+      g_free (name);
+
+      put_uleb (gen->types, 0);
+      gen_unit_end (gen->types, start);
+    }
+}
+
+
+static void
+gen_compile_unit (Gen *gen, gint i)
+{
+  GByteArray *buf = gen->info;
+  guint start = gen_unit_begin (buf);
+  guint64 low_pc = gen->address;
+  guint32 size = gen->children * GEN_FUNCTION_SIZE;
+  gen->address += size;
+
+  gchar *name = g_strdup_printf ("cu%d.c", i);
+  put_uleb (buf, ABBREV_COMPILE_UNIT);
+  put_strp (gen, buf, name);
+  put_u8 (buf, DW_LANG_C99);
+  put_u64 (buf, low_pc);
+  put_u32 (buf, size);
+  g_free (name);
+
+  /* dwz puts the imports first.  */
+  if (gen->partial_units > 0)
+    {
+      put_uleb (buf, ABBREV_IMPORTED_UNIT);
+      put_u32 (buf, g_array_index (gen->partial_dies, guint32,
+                                   i % gen->partial_units));
+    }
+
+  guint32 int_type = gen_base_type (gen, buf, start, "int");
+  guint32 type = int_type;
+  for (gint depth = 0; depth < gen->type_depth; ++depth)
+    {
+      name = g_strdup_printf ("s%d_%d", i, depth);
+      type = gen_struct (gen, buf, start, name, int_type,
+                         type != int_type ? type : 0);
+      g_free (name);
+    }
+
+  guint32 typedef_type = buf->len - start;
+  name = g_strdup_printf ("t%d", i);
+  put_uleb (buf, ABBREV_TYPEDEF);
+  put_strp (gen, buf, name);
+  put_u32 (buf, type);
+  g_free (name);
+
+  for (gint child = 0; child < gen->children; ++child)
+    {
+      name = g_strdup_printf ("f%d_%d", i, child);
+      put_uleb (buf, ABBREV_SUBPROGRAM);
+      put_strp (gen, buf, name);
+      put_u32 (buf, int_type);
+      put_u64 (buf, low_pc + child * GEN_FUNCTION_SIZE);
+      put_u32 (buf, GEN_FUNCTION_SIZE);
+      g_free (name);
+
+      put_uleb (buf, ABBREV_FORMAL_PARAMETER);
+      put_strp (gen, buf, "arg");
+      put_u32 (buf, typedef_type);
+
+      put_uleb (buf, ABBREV_FORMAL_PARAMETER);
+      put_strp (gen, buf, "count");
+      put_u32 (buf, int_type);
+
+      put_uleb (buf, ABBREV_VARIABLE);
+      put_strp (gen, buf, "local");
+      put_u32 (buf, typedef_type);
+
+      put_uleb (buf, 0);
+    }
+
+  if (gen->partial_units > 0)
+    {
+      put_uleb (buf, ABBREV_VARIABLE_ALT);
+      put_strp (gen, buf, "shared");
+      put_u32 (buf, g_array_index (gen->partial_structs, guint32,
+                                   i % gen->partial_units));
+    }
+
+  if (gen->type_units > 0)
+    {
+      put_uleb (buf, ABBREV_VARIABLE_SIG);
+      put_strp (gen, buf, "typed");
+      put_u64 (buf, gen_type_signature (i % gen->type_units));
+    }
+
+  put_uleb (buf, 0);
+  gen_unit_end (buf, start);
+}
+
+
+/* Write out the sections as an ET_REL object, with .text just to give the
+ * module an address range.  */
+static gboolean
+gen_write_elf (Gen *gen, const char *path)
+{
+  struct
+  {
+    const char *name;
+    Elf64_Word type;
+    Elf64_Xword flags;
+    gconstpointer data;
+    gsize size;
+  } sections[] =
+    {
+      { "", SHT_NULL, 0, NULL, 0 },
+      { ".shstrtab", SHT_STRTAB, 0, NULL, 0 },
+      { ".text", SHT_NOBITS, SHF_ALLOC | SHF_EXECINSTR, NULL, gen->address },
+      { ".debug_abbrev", SHT_PROGBITS, 0, gen->abbrev->data, gen->abbrev->len },
+      { ".debug_info", SHT_PROGBITS, 0, gen->info->data, gen->info->len },
+      { ".debug_str", SHT_PROGBITS, 0, gen->str->data, gen->str->len },
+      { ".debug_types", SHT_PROGBITS, 0, gen->types->data, gen->types->len },
+    };
+  guint n_sections = G_N_ELEMENTS (sections) - (gen->types->len == 0);
+
+  GByteArray *shstrtab = g_byte_array_new ();
+  Elf64_Shdr *shdrs = g_new0 (Elf64_Shdr, n_sections);
+  for (guint i = 0; i < n_sections; ++i)
+    {
+      shdrs[i].sh_name = shstrtab->len;
+      put (shstrtab, sections[i].name, strlen (sections[i].name) + 1);
+    }
+  sections[1].data = shstrtab->data;
+  sections[1].size = shstrtab->len;
+
+  Elf64_Off offset = sizeof (Elf64_Ehdr);
+  for (guint i = 1; i < n_sections; ++i)
+    {
+      shdrs[i].sh_type = sections[i].type;
+      shdrs[i].sh_flags = sections[i].flags;
+      shdrs[i].sh_offset = offset;
+      shdrs[i].sh_size = sections[i].size;
+      shdrs[i].sh_addralign = 1;
+      if (sections[i].type != SHT_NOBITS)
+        offset += sections[i].size;
+    }
+  offset = (offset + 7) & ~(Elf64_Off) 7;
+
+  Elf64_Ehdr ehdr;
+  memset (&ehdr, 0, sizeof ehdr);
+  memcpy (ehdr.e_ident, ELFMAG, SELFMAG);
+  ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr.e_ident[EI_DATA] = (G_BYTE_ORDER == G_LITTLE_ENDIAN
+                           ? ELFDATA2LSB : ELFDATA2MSB);
+  ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr.e_type = ET_REL;
+  ehdr.e_machine = GEN_MACHINE;
+  ehdr.e_version = EV_CURRENT;
+  ehdr.e_shoff = offset;
+  ehdr.e_ehsize = sizeof ehdr;
+  ehdr.e_shentsize = sizeof (Elf64_Shdr);
+  ehdr.e_shnum = n_sections;
+  ehdr.e_shstrndx = 1;
+
+  FILE *file = fopen (path, "wb");
+  gboolean ok = (file != NULL
+                 && fwrite (&ehdr, sizeof ehdr, 1, file) == 1);
+  for (guint i = 1; ok && i < n_sections; ++i)
+    if (sections[i].type != SHT_NOBITS && sections[i].size > 0)
+      ok = fwrite (sections[i].data, sections[i].size, 1, file) == 1;
+  if (ok)
+    {
+      static const char padding[8];
+      gsize pad = offset - ftell (file);
+      ok = (fwrite (padding, 1, pad, file) == pad
+            && fwrite (shdrs, sizeof *shdrs, n_sections, file) == n_sections);
+    }
+  if (file != NULL)
+    ok = (fclose (file) == 0) && ok;
+
+  g_free (shdrs);
+  g_byte_array_free (shstrtab, TRUE);
+  return ok;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  Gen gen;
+  memset (&gen, 0, sizeof gen);
+  gen.units = 1000;
+  gen.children = 20;
+  gen.type_depth = 4;
+
+  gchar *output = NULL;
+  GError *error = NULL;
+  GOptionEntry options[] =
+    {
+        {
+          "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+          "Write the object to FILE", "FILE"
+        },
+        {
+          "units", 'u', 0, G_OPTION_ARG_INT, &gen.units,
+          "Number of compile units", "N"
+        },
+        {
+          "children", 'c', 0, G_OPTION_ARG_INT, &gen.children,
+          "Number of functions in each compile unit", "N"
+        },
+        {
+          "type-depth", 'd', 0, G_OPTION_ARG_INT, &gen.type_depth,
+          "Length of each unit's chain of nested structs", "N"
+        },
+        {
+          "partial-units", 'p', 0, G_OPTION_ARG_INT, &gen.partial_units,
+          "Number of dwz-style partial units to import", "N"
+        },
+        {
+          "type-units", 't', 0, G_OPTION_ARG_INT, &gen.type_units,
+          "Number of .debug_types units", "N"
+        },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+
+  GOptionContext *context = g_option_context_new ("- generate DWARF");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  if (output == NULL || gen.units < 0 || gen.children < 0
+      || gen.type_depth < 0 || gen.partial_units < 0 || gen.type_units < 0)
+    {
+      g_printerr ("An --output file and non-negative counts are required.\n");
+      return EXIT_FAILURE;
+    }
+
+  gen.abbrev = g_byte_array_new ();
+  gen.info = g_byte_array_new ();
+  gen.types = g_byte_array_new ();
+  gen.str = g_byte_array_new ();
+  gen.strings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  gen_abbrevs (&gen);
+  gen_partial_units (&gen);
+  gen_type_units (&gen);
+  for (gint i = 0; i < gen.units; ++i)
+    gen_compile_unit (&gen, i);
+
+  gboolean ok = gen_write_elf (&gen, output);
+  if (!ok)
+    g_printerr ("Couldn't write %s\n", output);
+
+  g_hash_table_destroy (gen.strings);
+  g_byte_array_free (gen.str, TRUE);
+  g_byte_array_free (gen.types, TRUE);
+  g_byte_array_free (gen.info, TRUE);
+  g_byte_array_free (gen.abbrev, TRUE);
+  g_array_free (gen.partial_dies, TRUE);
+  g_array_free (gen.partial_structs, TRUE);
+  g_free (output);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
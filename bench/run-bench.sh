@@ -0,0 +1,56 @@
+#!/bin/sh
+# Generate synthetic DWARF and benchmark dwarvish against it.
+# Copyright (C) 2013  Josh Stone
+#
+# This file is part of dwarvish, and is free software: you can
+# redistribute it and/or modify it under the terms of the GNU General
+# Public License as published by the Free Software Foundation, either
+# version 3 of the License, or (at your option) any later version.
+#
+# This is run by "make bench" from the build directory.  Each result is a
+# line of JSON appended to $BENCH_OUTPUT, tagged with the build's git
+# description, so runs of different builds can be compared.  Set
+# BENCH_SAMPLES to repeat each run, and BENCH_FILES to add real binaries.
+
+set -e
+
+srcdir=${srcdir:-$(dirname "$0")/..}
+output=${BENCH_OUTPUT:-bench-results.jsonl}
+samples=${BENCH_SAMPLES:-3}
+data=bench/data
+
+build=$(git -C "$srcdir" describe --always --dirty 2>/dev/null || echo unknown)
+
+mkdir -p "$data"
+
+# name, then generator options
+gen() {
+    name=$1
+    shift
+    if [ ! -f "$data/$name.o" ]; then
+        echo "  GEN      $data/$name.o"
+        ./bench/gen-dwarf --output="$data/$name.o" "$@"
+    fi
+}
+
+gen small --units=100
+gen wide --units=2000 --children=50
+gen deep --units=500 --type-depth=64
+gen dwz --units=2000 --partial-units=200
+gen types --units=2000 --type-units=2000
+
+./bench/dwstring-bench "$build" >>"$output"
+
+for name in small wide deep dwz types; do
+    echo "  BENCH    $name"
+    ./bench/dwarvish-bench --label="$name" --build="$build" \
+        --samples="$samples" "$data/$name.o" >>"$output"
+done
+
+for file in $BENCH_FILES; do
+    echo "  BENCH    $file"
+    ./bench/dwarvish-bench --build="$build" \
+        --samples="$samples" "$file" >>"$output"
+done
+
+echo "Results appended to $output"
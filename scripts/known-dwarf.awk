@@ -39,6 +39,11 @@ $1 ~ /DW([_A-Z]+)_([^ ]+)/ {
     DW[set] = DW[set] "," elt;
   else
     DW[set] = elt;
+  val = $3;
+  sub(/,$/, "", val);
+  sub(/[uUlL]+$/, "", val);
+  if (val ~ /^(0[xX][[:xdigit:]]+|[[:digit:]]+)$/)
+    code[set, elt] = strtonum(val);
   if ($NF == "*/" && $4 == "/*") {
     c = $5;
     for (i = 6; i < NF; ++i) c = c " " $i;
@@ -46,6 +51,15 @@ $1 ~ /DW([_A-Z]+)_([^ ]+)/ {
   }
 }
 
+# Print one list of a set's names, in the given asorti order.
+function print_known(set, kind, list, order,    names, k, n) {
+  n = asorti(list, names, order);
+  print "\n#define ALL_KNOWN_DW_" set "_" kind " \\";
+  for (k = 1; k <= n; ++k)
+    print "  ONE_KNOWN_DW (" names[k] ", DW_" set "_" names[k] ") \\";
+  print "  /* End of DW_" set "_*_" kind ".  */";
+}
+
 END {
   print "/* Generated by known-dwarf.awk from dwarf.h contents.  */";
   n = asorti(DW, sets);
@@ -74,6 +88,27 @@ END {
 	print "  ONE_KNOWN_DW (" elt ", DW_" set "_" elt ") \\";
     }
     print "  /* End of DW_" set "_*.  */";
+
+    # The same names again, split for lookup tables.  Small codes index a
+    # dense array, the rest are sorted by code for a binary search, and any
+    # whose value couldn't be read are left for a switch.
+    delete dense;
+    delete sparse;
+    delete slow;
+    for (j = 1; j <= m; ++j) {
+      elt = elts[j];
+      if (elt == lo || elt == hi)
+	continue;
+      if (!((set, elt) in code))
+	slow[elt] = elt;
+      else if (code[set, elt] < 256)
+	dense[elt] = code[set, elt];
+      else
+	sparse[elt] = code[set, elt];
+    }
+    print_known(set, "DENSE", dense, "@val_num_asc");
+    print_known(set, "SPARSE", sparse, "@val_num_asc");
+    print_known(set, "SLOW", slow, "@ind_str_asc");
   }
   print "\n#define ALL_KNOWN_DW_SETS \\";
   for (i = 1; i <= n; ++i) {
@@ -0,0 +1,306 @@
+/*
+ * Address index implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <dwarf.h>
+#include "addrindex.h"
+#include "addrtable.h"
+#include "profile.h"
+
+
+/* Addresses are found in two levels of interval tables.  The units' ranges
+ * come from .debug_aranges, and any units it leaves out are scanned for
+ * their own ranges in the background.  The ranges of a unit's
+ * functions are only gathered when an address first lands in that unit.
+ * From the function, the innermost scope with the address is found by
+ * following children which have it.  Addresses are as in the DWARF,
+ * without any module bias.  */
+typedef struct _AddrUnit
+{
+  Dwarf_Off die;        /* Of the unit DIE.  */
+  Dwarf_Off offset;     /* Of the unit header.  */
+} AddrUnit;
+
+struct _AddrIndex
+{
+  DwarvishSession *session;
+
+  GArray *units;        /* AddrUnit of units missing from the aranges.  */
+  gint cancelled;
+  gint ready;
+  GThread *thread;
+
+  AddrTable table;      /* Of the units, once ready.  */
+  GHashTable *functions;        /* Unit offset to AddrTable of functions.  */
+};
+
+
+static int
+addr_offset_compare (const void *a, const void *b)
+{
+  const Dwarf_Off *oa = a, *ob = b;
+  return (*oa > *ob) - (*oa < *ob);
+}
+
+
+static void
+addr_table_free (gpointer data)
+{
+  addr_table_clear (data);
+  g_slice_free (AddrTable, data);
+}
+
+
+/* Only the unit DIEs are read, which is little enough for one thread.
+ * Libdw handles aren't safe to share between threads, so it reads its own
+ * clone of the session, and without one only the aranges are used.  */
+static gpointer
+addr_index_thread (gpointer data)
+{
+  AddrIndex *index = data;
+  gint64 start = profile_begin ();
+
+  const char *error;
+  DwarvishSession *clone = (index->units->len > 0
+                            ? session_clone (index->session, &error) : NULL);
+  if (clone != NULL)
+    {
+      for (guint i = 0; (i < index->units->len
+                         && !g_atomic_int_get (&index->cancelled)); ++i)
+        {
+          AddrUnit *unit = &g_array_index (index->units, AddrUnit, i);
+          Dwarf_Die die;
+          if (dwarf_offdie (clone->dwarf, unit->die, &die) != NULL)
+            addr_table_add_die (&index->table, &die, unit->offset);
+        }
+      session_end (clone);
+    }
+
+  addr_table_sort (&index->table);
+  profile_end (start, "build address index");
+  g_atomic_int_set (&index->ready, TRUE);
+  return NULL;
+}
+
+
+/* Take the unit ranges that .debug_aranges has, and list the units it
+ * doesn't for the thread.  Partial units have no code of their own.  */
+static void
+addr_index_add_units (AddrIndex *index, Dwarf *dwarf)
+{
+  Dwarf_Aranges *aranges;
+  size_t naranges;
+  if (dwarf_getaranges (dwarf, &aranges, &naranges) != 0)
+    naranges = 0;
+
+  GArray *covered = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+  for (size_t i = 0; i < naranges; ++i)
+    {
+      Dwarf_Addr addr;
+      Dwarf_Word length;
+      Dwarf_Off offset;
+      if (dwarf_getarangeinfo (dwarf_onearange (aranges, i),
+                               &addr, &length, &offset) != 0
+          || length == 0)
+        continue;
+
+      addr_table_add (&index->table, addr, addr + length, offset);
+      g_array_append_val (covered, offset);
+    }
+  qsort (covered->data, covered->len, sizeof (Dwarf_Off),
+         addr_offset_compare);
+
+  size_t cuhl;
+  for (Dwarf_Off noff, off = 0;
+       dwarf_next_unit (dwarf, off, &noff, &cuhl, NULL, NULL, NULL, NULL,
+                        NULL, NULL) == 0;
+       off = noff)
+    {
+      if (bsearch (&off, covered->data, covered->len, sizeof (Dwarf_Off),
+                   addr_offset_compare) != NULL)
+        continue;
+
+      Dwarf_Die die;
+      AddrUnit unit = { off + cuhl, off };
+      if (dwarf_offdie (dwarf, unit.die, &die) != NULL
+          && dwarf_tag (&die) != DW_TAG_partial_unit)
+        g_array_append_val (index->units, unit);
+    }
+
+  g_array_free (covered, TRUE);
+}
+
+
+/* Get the address index, starting to build it in the background if
+ * needed.  */
+AddrIndex *
+addr_index_get (DwarvishSession *session)
+{
+  AddrIndex *index = session->addr_index;
+  if (index != NULL)
+    return index;
+
+  index = g_slice_new0 (AddrIndex);
+  index->session = session;
+  index->units = g_array_new (FALSE, FALSE, sizeof (AddrUnit));
+  index->functions = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                            g_free, addr_table_free);
+  addr_table_init (&index->table);
+  session->addr_index = index;
+
+  /* The aranges are read here on the main thread, as libdw allocates
+   * them in memory shared by the whole Dwarf.  */
+  addr_index_add_units (index, session->dwarf);
+
+  index->thread = g_thread_new ("dwarvish-addrs", addr_index_thread, index);
+  return index;
+}
+
+
+gboolean
+addr_index_ready (AddrIndex *index)
+{
+  return g_atomic_int_get (&index->ready);
+}
+
+
+/* Gather the functions of a unit, including those in namespaces and
+ * classes.  */
+static void
+addr_index_add_functions (AddrTable *table, Dwarf_Die *parent)
+{
+  Dwarf_Die child;
+  if (dwarf_child (parent, &child) == 0)
+    do
+      switch (dwarf_tag (&child))
+        {
+        case DW_TAG_subprogram:
+          addr_table_add_die (table, &child, dwarf_dieoffset (&child));
+          break;
+
+        case DW_TAG_namespace:
+        case DW_TAG_module:
+        case DW_TAG_class_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_union_type:
+          addr_index_add_functions (table, &child);
+          break;
+        }
+    while (dwarf_siblingof (&child, &child) == 0);
+}
+
+
+static AddrTable *
+addr_index_get_functions (AddrIndex *index, Dwarf_Off offset, Dwarf_Die *unit)
+{
+  AddrTable *table = g_hash_table_lookup (index->functions, &offset);
+  if (table == NULL)
+    {
+      table = g_slice_new (AddrTable);
+      addr_table_init (table);
+      addr_index_add_functions (table, unit);
+      addr_table_sort (table);
+      g_hash_table_insert (index->functions,
+                           g_memdup (&offset, sizeof offset), table);
+    }
+  return table;
+}
+
+
+/* Find the unit with the address, and then the function within it,
+ * leaving the unit's DIE if there's no function.  */
+static gboolean
+addr_index_find (AddrIndex *index, Dwarf_Addr pc, Dwarf_Die *die,
+                 gboolean *in_function)
+{
+  if (!addr_index_ready (index))
+    return FALSE;
+
+  const AddrRange *unit = addr_table_find (&index->table, pc);
+  if (unit == NULL)
+    return FALSE;
+
+  Dwarf *dwarf = index->session->dwarf;
+  size_t cuhl;
+  Dwarf_Off noff;
+  if (dwarf_next_unit (dwarf, unit->offset, &noff, &cuhl, NULL, NULL, NULL,
+                       NULL, NULL, NULL) != 0
+      || dwarf_offdie (dwarf, unit->offset + cuhl, die) == NULL)
+    return FALSE;
+
+  AddrTable *functions = addr_index_get_functions (index, unit->offset, die);
+  const AddrRange *function = addr_table_find (functions, pc);
+  Dwarf_Die scope;
+  *in_function = (function != NULL
+                  && dwarf_offdie (dwarf, function->offset, &scope) != NULL);
+  if (*in_function)
+    *die = scope;
+  return TRUE;
+}
+
+
+/* Find the function with the address, from its unit's table.  */
+gboolean
+addr_index_function (AddrIndex *index, Dwarf_Addr pc, Dwarf_Die *function)
+{
+  gboolean in_function;
+  return addr_index_find (index, pc, function, &in_function) && in_function;
+}
+
+
+/* Find the innermost DIE with the address: its unit, then the function,
+ * then any lexical blocks and inlined subroutines within.  */
+gboolean
+addr_index_lookup (AddrIndex *index, Dwarf_Addr pc, Dwarf_Die *die)
+{
+  gboolean in_function;
+  if (!addr_index_find (index, pc, die, &in_function))
+    return FALSE;
+
+  Dwarf_Die scope;
+  for (gboolean found = TRUE; found; )
+    {
+      found = FALSE;
+      if (dwarf_child (die, &scope) == 0)
+        do
+          if (dwarf_haspc (&scope, pc) > 0)
+            {
+              *die = scope;
+              found = TRUE;
+            }
+        while (!found && dwarf_siblingof (&scope, &scope) == 0);
+    }
+
+  return TRUE;
+}
+
+
+void
+addr_index_free (DwarvishSession *session)
+{
+  AddrIndex *index = session->addr_index;
+  if (index == NULL)
+    return;
+
+  g_atomic_int_set (&index->cancelled, TRUE);
+  g_thread_join (index->thread);
+
+  g_array_free (index->units, TRUE);
+  addr_table_clear (&index->table);
+  g_hash_table_destroy (index->functions);
+  g_slice_free (AddrIndex, index);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,46 @@
+/*
+ * Address index interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ADDRINDEX_H_
+#define _ADDRINDEX_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+typedef struct _AddrIndex AddrIndex;
+
+
+G_GNUC_INTERNAL
+AddrIndex *addr_index_get (DwarvishSession *session);
+
+G_GNUC_INTERNAL
+gboolean addr_index_ready (AddrIndex *index);
+
+G_GNUC_INTERNAL
+gboolean addr_index_function (AddrIndex *index,
+                              Dwarf_Addr pc,
+                              Dwarf_Die *function);
+
+G_GNUC_INTERNAL
+gboolean addr_index_lookup (AddrIndex *index,
+                            Dwarf_Addr pc,
+                            Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+void addr_index_free (DwarvishSession *session);
+
+
+#endif /* _ADDRINDEX_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,129 @@
+/*
+ * Address interval table implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include "addrtable.h"
+
+
+static int
+addr_range_compare (const void *a, const void *b)
+{
+  const AddrRange *ra = a, *rb = b;
+  return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+
+void
+addr_table_init (AddrTable *table)
+{
+  table->ranges = g_array_new (FALSE, FALSE, sizeof (AddrRange));
+  table->max_ends = g_array_new (FALSE, FALSE, sizeof (Dwarf_Addr));
+}
+
+
+/* Add a range, which is only found once the table is sorted again.  */
+void
+addr_table_add (AddrTable *table, Dwarf_Addr start, Dwarf_Addr end,
+                Dwarf_Off offset)
+{
+  if (start < end)
+    {
+      AddrRange range = { start, end, offset };
+      g_array_append_val (table->ranges, range);
+    }
+}
+
+
+/* Add all the ranges of a DIE's code.  */
+void
+addr_table_add_die (AddrTable *table, Dwarf_Die *die, Dwarf_Off offset)
+{
+  Dwarf_Addr base, start, end;
+  ptrdiff_t next = 0;
+  while ((next = dwarf_ranges (die, next, &base, &start, &end)) > 0)
+    addr_table_add (table, start, end, offset);
+}
+
+
+void
+addr_table_sort (AddrTable *table)
+{
+  qsort (table->ranges->data, table->ranges->len, sizeof (AddrRange),
+         addr_range_compare);
+
+  Dwarf_Addr max_end = 0;
+  g_array_set_size (table->max_ends, table->ranges->len);
+  for (guint i = 0; i < table->ranges->len; ++i)
+    {
+      max_end = MAX (max_end, g_array_index (table->ranges, AddrRange, i).end);
+      g_array_index (table->max_ends, Dwarf_Addr, i) = max_end;
+    }
+}
+
+
+/* Get the number of ranges starting at or before the address.  */
+static guint
+addr_table_bound (AddrTable *table, Dwarf_Addr pc)
+{
+  const AddrRange *ranges = (const AddrRange *) table->ranges->data;
+  guint lo = 0, hi = table->ranges->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      if (ranges[mid].start <= pc)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+
+/* Find the latest starting range with the address.  */
+const AddrRange *
+addr_table_find (AddrTable *table, Dwarf_Addr pc)
+{
+  const AddrRange *ranges = (const AddrRange *) table->ranges->data;
+  const Dwarf_Addr *max_ends = (const Dwarf_Addr *) table->max_ends->data;
+
+  for (guint i = addr_table_bound (table, pc); i-- > 0 && max_ends[i] > pc; )
+    if (ranges[i].end > pc)
+      return &ranges[i];
+  return NULL;
+}
+
+
+/* Append the offsets of all the ranges with the address, latest start
+ * first.  */
+void
+addr_table_find_all (AddrTable *table, Dwarf_Addr pc, GArray *offsets)
+{
+  const AddrRange *ranges = (const AddrRange *) table->ranges->data;
+  const Dwarf_Addr *max_ends = (const Dwarf_Addr *) table->max_ends->data;
+
+  for (guint i = addr_table_bound (table, pc); i-- > 0 && max_ends[i] > pc; )
+    if (ranges[i].end > pc)
+      g_array_append_val (offsets, ranges[i].offset);
+}
+
+
+void
+addr_table_clear (AddrTable *table)
+{
+  g_array_free (table->ranges, TRUE);
+  g_array_free (table->max_ends, TRUE);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,68 @@
+/*
+ * Address interval table interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ADDRTABLE_H_
+#define _ADDRTABLE_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+
+typedef struct _AddrRange
+{
+  Dwarf_Addr start;
+  Dwarf_Addr end;       /* Exclusive.  */
+  Dwarf_Off offset;     /* Of whatever the range belongs to.  */
+} AddrRange;
+
+/* Ranges sorted by start, each with the greatest end of any up to it, so
+ * the ranges with an address are a binary search and then a walk back only
+ * as far as an earlier range could still reach it.  */
+typedef struct _AddrTable
+{
+  GArray *ranges;       /* AddrRange */
+  GArray *max_ends;     /* Dwarf_Addr */
+} AddrTable;
+
+
+G_GNUC_INTERNAL
+void addr_table_init (AddrTable *table);
+
+G_GNUC_INTERNAL
+void addr_table_add (AddrTable *table,
+                     Dwarf_Addr start,
+                     Dwarf_Addr end,
+                     Dwarf_Off offset);
+
+G_GNUC_INTERNAL
+void addr_table_add_die (AddrTable *table,
+                         Dwarf_Die *die,
+                         Dwarf_Off offset);
+
+G_GNUC_INTERNAL
+void addr_table_sort (AddrTable *table);
+
+G_GNUC_INTERNAL
+const AddrRange *addr_table_find (AddrTable *table,
+                                  Dwarf_Addr pc);
+
+G_GNUC_INTERNAL
+void addr_table_find_all (AddrTable *table,
+                          Dwarf_Addr pc,
+                          GArray *offsets);
+
+G_GNUC_INTERNAL
+void addr_table_clear (AddrTable *table);
+
+
+#endif /* _ADDRTABLE_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
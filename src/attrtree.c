@@ -16,58 +16,28 @@
 #include "dwstring.h"
 
 #include "attrtree.h"
+#include "cuinfo.h"
 #include "dietree.h"
-#include "util.h"
+#include "location.h"
+#include "profile.h"
 
 
+/* The store only keeps codes and a pointer to the rendered row, which is
+ * owned by the store's row cache, and text is formatted as it's drawn.
+ * Rows waiting to be filled on expansion have a NULL row.  */
 enum
 {
-  ATTR_TREE_COL_ATTRIBUTE = 0,
-  ATTR_TREE_COL_FORM,
-  ATTR_TREE_COL_VALUE,
-  ATTR_TREE_INT_DIE,
-  ATTR_TREE_INT_ATTR,
+  ATTR_TREE_COL_ATTRIBUTE = 0,  /* gint */
+  ATTR_TREE_COL_FORM,           /* gint */
+  ATTR_TREE_COL_VALUE,          /* AttrRow * */
   ATTR_TREE_N_COLUMNS
 };
 
 
-static G_DEFINE_SLICED_COPY (Dwarf_Attribute, dwarf_attr);
-static G_DEFINE_SLICED_FREE (Dwarf_Attribute, dwarf_attr);
-G_DEFINE_SLICED_BOXED_TYPE (Dwarf_Attribute, dwarf_attr);
-#define G_TYPE_DWARF_ATTR (dwarf_attr_get_type ())
-
-
-gboolean
-attr_tree_get_attribute (GtkTreeModel *model, GtkTreeIter *iter,
-                         Dwarf_Attribute *attr_mem)
-{
-  Dwarf_Attribute *attr = NULL;
-  gtk_tree_model_get (model, iter, ATTR_TREE_INT_ATTR, &attr, -1);
-  if (attr == NULL)
-    return FALSE;
-  *attr_mem = *attr;
-  dwarf_attr_free (attr);
-  return TRUE;
-}
-
-
-/* Like dwarf_decl_file for an already known DW_AT_decl_file.  This might be
- * a bit paranoid, but it's more directly showing what's specified.  */
-static const char *
-dwarf_die_file_idx (Dwarf_Die *die, size_t idx)
-{
-  Dwarf_Die cu;
-  Dwarf_Files *files;
-  if (dwarf_diecu (die, &cu, NULL, NULL) != NULL &&
-      dwarf_getsrcfiles (&cu, &files, NULL) == 0)
-    return dwarf_filesrc (files, idx, NULL, NULL);
-  return NULL;
-}
-
-
 /* Print special cases of data attributes.  */
 static char *
-attr_value_data_string (Dwarf_Die *die, Dwarf_Attribute *attr)
+attr_value_data_string (DwarvishSession *session, Dwarf_Die *die,
+                        Dwarf_Attribute *attr)
 {
   Dwarf_Word udata;
   if (dwarf_formudata (attr, &udata) != 0)
@@ -79,7 +49,7 @@ attr_value_data_string (Dwarf_Die *die, Dwarf_Attribute *attr)
     {
     case DW_AT_call_file:
     case DW_AT_decl_file:
-      str = dwarf_die_file_idx (die, udata);
+      str = cu_info_file (session, die, udata);
       if (str != NULL)
         return g_strdup (str);
       break;
@@ -125,27 +95,77 @@ attr_value_data_string (Dwarf_Die *die, Dwarf_Attribute *attr)
     }
 
   /* Print signed and small-unsigned constants in decimal.  */
-  if (udata < 0x10000 || dwarf_whatform (attr) == DW_FORM_sdata)
+  int form = dwarf_whatform (attr);
+  if (udata < 0x10000 || form == DW_FORM_sdata
+#ifdef HAVE_DWARF_CU_INFO
+      || form == DW_FORM_implicit_const
+#endif
+      )
     return g_strdup_printf ("%" G_GINT64_FORMAT, udata);
 
   return g_strdup_printf ("%#" G_GINT64_MODIFIER "x", udata);
 }
 
 
+/* Location and range lists are decoded, and other section offsets are
+ * just printed as a [ref].  */
 static char *
-attr_value_sec_offset_string (Dwarf_Attribute *attr)
+attr_value_sec_offset_string (Dwarf_Die *die, Dwarf_Attribute *attr)
 {
+  if (dwarf_whatattr (attr) == DW_AT_ranges)
+    return location_ranges_string (die);
+  if (location_attr_is_location (attr))
+    return location_list_string (attr);
+
   Dwarf_Word udata;
   if (dwarf_formudata (attr, &udata) != 0)
     return NULL;
-
-  /* For now, just print section offsets as a [ref].  */
   return g_strdup_printf ("[%" G_GINT64_MODIFIER "x]", udata);
 }
 
 
+/* Before DWARF 4, section offsets were plain data forms.  These
+ * attributes have no constant class from then on either, so an unknown
+ * version is taken to be an old one.  */
+static gboolean
+attr_value_is_sec_offset (DwarvishSession *session, Dwarf_Die *die,
+                          Dwarf_Attribute *attr)
+{
+  CuInfo *info = cu_info_lookup (session, die);
+  if (info != NULL && info->have_header && info->version >= 4)
+    return FALSE;
+
+  int name = dwarf_whatattr (attr);
+  return name == DW_AT_ranges
+    || (name != DW_AT_data_member_location
+        && location_attr_is_location (attr));
+}
+
+
+/* Blocks are expressions if they're locations, else just bytes.  */
 static char *
-attr_value_string (Dwarf_Die *die, Dwarf_Attribute *attr)
+attr_value_block_string (Dwarf_Attribute *attr)
+{
+  if (dwarf_whatform (attr) == DW_FORM_exprloc
+      || location_attr_is_location (attr))
+    return location_list_string (attr);
+
+  Dwarf_Block block;
+  if (dwarf_formblock (attr, &block) != 0)
+    return NULL;
+
+  GString *out = g_string_new (NULL);
+  for (Dwarf_Word i = 0; i < block.length; ++i)
+    g_string_append_printf (out, i ? " %02x" : "%02x", block.data[i]);
+  return g_string_free (out, FALSE);
+}
+
+
+/* The DWARF 5 and split forms are only known to a libdw which can read
+ * them, from 0.171.  */
+char *
+attr_tree_value_string (DwarvishSession *session, Dwarf_Die *die,
+                        Dwarf_Attribute *attr)
 {
   bool flag;
   Dwarf_Die ref;
@@ -156,6 +176,14 @@ attr_value_string (Dwarf_Die *die, Dwarf_Attribute *attr)
   switch (dwarf_whatform (attr))
     {
     case DW_FORM_addr:
+#ifdef HAVE_DWARF_CU_INFO
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+    case DW_FORM_GNU_addr_index:
+#endif
       if (dwarf_formaddr (attr, &addr) == 0)
         return g_strdup_printf ("%#" G_GINT64_MODIFIER "x", addr);
       return NULL;
@@ -164,6 +192,15 @@ attr_value_string (Dwarf_Die *die, Dwarf_Attribute *attr)
     case DW_FORM_strp:
     case DW_FORM_string:
     case DW_FORM_GNU_strp_alt:
+#ifdef HAVE_DWARF_CU_INFO
+    case DW_FORM_line_strp:
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4:
+    case DW_FORM_GNU_str_index:
+#endif
       str = dwarf_formstring (attr);
       return (str != NULL) ? g_strdup (str) : NULL;
 
@@ -176,27 +213,31 @@ attr_value_string (Dwarf_Die *die, Dwarf_Attribute *attr)
     case DW_FORM_GNU_ref_alt:
     case DW_FORM_ref_sig8:
       if (dwarf_formref_die (attr, &ref) != NULL)
-        {
-          Dwarf_Off offset = dwarf_dieoffset (&ref);
-          const char *tag = DW_TAG__string (dwarf_tag (&ref));
-          if (G_LIKELY (tag != NULL))
-            return g_strdup_printf ("[%" G_GINT64_MODIFIER "x] %s",
-                                    offset, tag);
-          return g_strdup_printf ("[%" G_GINT64_MODIFIER "x] %#x",
-                                  offset, dwarf_tag (&ref));
-        }
+        return g_strdup_printf ("[%" G_GINT64_MODIFIER "x] %s",
+                                dwarf_dieoffset (&ref),
+                                DW_TAG__name (dwarf_tag (&ref)));
       return NULL;
 
     case DW_FORM_sec_offset:
-      return attr_value_sec_offset_string (attr);
+#ifdef HAVE_DWARF_CU_INFO
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+#endif
+      return attr_value_sec_offset_string (die, attr);
 
-    case DW_FORM_udata:
     case DW_FORM_data8:
     case DW_FORM_data4:
+      if (attr_value_is_sec_offset (session, die, attr))
+        return attr_value_sec_offset_string (die, attr);
+      /* Fall through.  */
+    case DW_FORM_udata:
     case DW_FORM_data2:
     case DW_FORM_data1:
     case DW_FORM_sdata:
-      return attr_value_data_string (die, attr);
+#ifdef HAVE_DWARF_CU_INFO
+    case DW_FORM_implicit_const:
+#endif
+      return attr_value_data_string (session, die, attr);
 
     case DW_FORM_flag:
       if (dwarf_formflag (attr, &flag) == 0)
@@ -211,7 +252,10 @@ attr_value_string (Dwarf_Die *die, Dwarf_Attribute *attr)
     case DW_FORM_block2:
     case DW_FORM_block4:
     case DW_FORM_exprloc:
-      /* TODO */
+#ifdef HAVE_DWARF_CU_INFO
+    case DW_FORM_data16:
+#endif
+      return attr_value_block_string (attr);
 
     default:
       return NULL;
@@ -219,15 +263,65 @@ attr_value_string (Dwarf_Die *die, Dwarf_Attribute *attr)
 }
 
 
+/* The rows for each DIE's attributes are rendered once per selection, even
+ * if the DIE is reached through many references.  */
+typedef struct _AttrRow
+{
+  gchar *value;
+  void *die_addr;       /* The DIE which has this attribute.  */
+  Dwarf_Attribute attr;
+  gboolean has_ref;     /* Whether the referenced DIE is listed below.  */
+  Dwarf_Die ref;
+} AttrRow;
+
+typedef struct _AttrFill
+{
+  DwarvishSession *session;
+  GtkTreeStore *store;
+  GHashTable *rows;     /* DIE addr -> GArray of AttrRow.  */
+  GHashTable *open;     /* DIE addrs listed on the way to this row.  */
+} AttrFill;
+
+
+static void
+attr_rows_free (gpointer data)
+{
+  GArray *rows = data;
+  for (guint i = 0; i < rows->len; ++i)
+    {
+      AttrRow *row = &g_array_index (rows, AttrRow, i);
+      g_free (row->value);
+    }
+  g_array_free (rows, TRUE);
+}
+
+
+static AttrRow *
+attr_tree_get_row (GtkTreeModel *model, GtkTreeIter *iter)
+{
+  AttrRow *row = NULL;
+  gtk_tree_model_get (model, iter, ATTR_TREE_COL_VALUE, &row, -1);
+  return row;
+}
+
+
+gboolean
+attr_tree_get_attribute (GtkTreeModel *model, GtkTreeIter *iter,
+                         Dwarf_Attribute *attr_mem)
+{
+  AttrRow *row = attr_tree_get_row (model, iter);
+  if (row == NULL)
+    return FALSE;
+  *attr_mem = row->attr;
+  return TRUE;
+}
+
+
 typedef struct _AttrCallback
 {
-  gboolean explicit_siblings;
+  DwarvishSession *session;
   Dwarf_Die *die;
-  GtkTreeStore *store;
-  GtkTreeIter *parent;
-  GtkTreeIter *sibling;
-  GtkTreeIter iter;
-  struct _AttrCallback *back;
+  GArray *rows;
 } AttrCallback;
 
 
@@ -235,55 +329,240 @@ static int
 getattrs_callback (Dwarf_Attribute *attr, void *user_data)
 {
   AttrCallback *data = (AttrCallback *)user_data;
-  Dwarf_Die *die = data->die;
 
   /* Siblings are hidden by default, as they're not really information
    * about the selected DIE itself.  */
   gboolean is_sibling = (dwarf_whatattr (attr) == DW_AT_sibling);
-  if (is_sibling && !data->explicit_siblings)
+  if (is_sibling && !data->session->explicit_siblings)
     return DWARF_CB_OK;
 
-  gchar *attribute = DW_AT__strdup_hex (dwarf_whatattr (attr));
-  gchar *form = DW_FORM__strdup_hex (dwarf_whatform (attr));
-  gchar *value = attr_value_string (die, attr);
-
-  gtk_tree_store_insert_after (data->store, &data->iter,
-                               data->parent, data->sibling);
-  gtk_tree_store_set (data->store, &data->iter,
-                      ATTR_TREE_COL_ATTRIBUTE, attribute,
-                      ATTR_TREE_COL_FORM, form,
-                      ATTR_TREE_COL_VALUE, value,
-                      ATTR_TREE_INT_DIE, die,
-                      ATTR_TREE_INT_ATTR, attr,
-                      -1);
-
-  g_free (attribute);
-  g_free (form);
-  g_free (value);
+  AttrRow row;
+  row.value = attr_tree_value_string (data->session, data->die, attr);
+  PROFILE_COUNT (PROFILE_ATTRS_RENDERED, 1);
+  row.die_addr = data->die->addr;
+  row.attr = *attr;
 
   /* Even when sibling attributes are explicitly shown, don't recurse on them,
    * as they're already shown as neighbors in the die tree.  */
-  Dwarf_Die ref;
-  if (!is_sibling && dwarf_formref_die (attr, &ref) != NULL)
+  row.has_ref = (!is_sibling && dwarf_formref_die (attr, &row.ref) != NULL);
+
+  g_array_append_val (data->rows, row);
+  return DWARF_CB_OK;
+}
+
+
+static GArray *
+attr_tree_get_rows (AttrFill *fill, Dwarf_Die *die)
+{
+  GArray *rows = g_hash_table_lookup (fill->rows, die->addr);
+  if (rows == NULL)
     {
-      /* Scan backwards to avoid expanding cycles.  */
-      AttrCallback *match = data;
-      while (match && match->die->addr != ref.addr)
-        match = match->back;
+      gint64 start = profile_begin ();
+      AttrCallback cbdata;
+      cbdata.session = fill->session;
+      cbdata.die = die;
+      cbdata.rows = rows = g_array_new (FALSE, FALSE, sizeof (AttrRow));
+      dwarf_getattrs (die, getattrs_callback, &cbdata, 0);
+      g_hash_table_insert (fill->rows, die->addr, rows);
+      profile_end (start, "attr values");
+    }
+  return rows;
+}
+
+
+/* Add one attribute row of a DIE, and below it the attributes of the DIE
+ * it references to the given depth.  Deeper references get an empty row to
+ * be replaced on expansion, unless they would form a cycle.  */
+static void attr_tree_fill (AttrFill *fill, Dwarf_Die *die,
+                            GtkTreeIter *parent, guint depth);
+
+static void
+attr_tree_fill_row (AttrFill *fill, AttrRow *row, GtkTreeIter *parent,
+                    guint depth)
+{
+  GtkTreeIter iter;
+  gtk_tree_store_append (fill->store, &iter, parent);
+  gtk_tree_store_set (fill->store, &iter,
+                      ATTR_TREE_COL_ATTRIBUTE, dwarf_whatattr (&row->attr),
+                      ATTR_TREE_COL_FORM, dwarf_whatform (&row->attr),
+                      ATTR_TREE_COL_VALUE, row,
+                      -1);
+
+  if (!row->has_ref || g_hash_table_contains (fill->open, row->ref.addr))
+    return;
 
-      if (match == NULL)
+  if (depth > 0)
+    attr_tree_fill (fill, &row->ref, &iter, depth - 1);
+  else
+    {
+      GtkTreeIter placeholder;
+      gtk_tree_store_append (fill->store, &placeholder, &iter);
+    }
+}
+
+
+/* List all of a DIE's attributes under the parent row.  */
+static void
+attr_tree_fill (AttrFill *fill, Dwarf_Die *die, GtkTreeIter *parent,
+                guint depth)
+{
+  GArray *rows = attr_tree_get_rows (fill, die);
+  g_hash_table_add (fill->open, die->addr);
+
+  for (guint i = 0; i < rows->len; ++i)
+    attr_tree_fill_row (fill, &g_array_index (rows, AttrRow, i),
+                        parent, depth);
+
+  g_hash_table_remove (fill->open, die->addr);
+}
+
+
+static void
+attr_tree_fill_init (AttrFill *fill, GtkTreeStore *store)
+{
+  fill->session = g_object_get_data (G_OBJECT (store), "DwarvishSession");
+  fill->store = store;
+  fill->rows = g_object_get_data (G_OBJECT (store), "AttrTreeRows");
+  fill->open = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+
+/* Each selection gets a new store, with the rendered rows kept alongside
+ * for as long as it's shown.  */
+static GtkTreeStore *
+attr_tree_store_new (DwarvishSession *session)
+{
+  GtkTreeStore *store = gtk_tree_store_new (ATTR_TREE_N_COLUMNS,
+                                            G_TYPE_INT,
+                                            G_TYPE_INT,
+                                            G_TYPE_POINTER);
+  g_object_set_data (G_OBJECT (store), "DwarvishSession", session);
+  g_object_set_data_full (G_OBJECT (store), "AttrTreeRows",
+                          g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 NULL, attr_rows_free),
+                          (GDestroyNotify) g_hash_table_destroy);
+  return store;
+}
+
+
+/* Build a DIE's whole store at once, as a refresh does in steps.  */
+GtkTreeModel *
+attr_tree_model_new (DwarvishSession *session, Dwarf_Die *die)
+{
+  AttrFill fill;
+  attr_tree_fill_init (&fill, attr_tree_store_new (session));
+  attr_tree_fill (&fill, die, NULL, session->attr_depth);
+  g_hash_table_destroy (fill.open);
+  return GTK_TREE_MODEL (fill.store);
+}
+
+
+/* Selection changes are coalesced, so only the cursor's final resting
+ * place is rendered.  Its rows are built in time-limited idle steps into a
+ * store which isn't shown yet, and then that's swapped into the view.  A
+ * newer selection simply drops whatever was still being built.  */
+#define ATTR_TREE_DEBOUNCE_MS 30
+#define ATTR_TREE_FILL_BUDGET_US 5000
+
+typedef struct _AttrRefresh
+{
+  GtkTreeView *view;
+  GtkTreeSelection *selection;  /* In the die tree.  */
+  guint debounce_id;
+
+  /* The render in progress, if any.  */
+  guint fill_id;
+  AttrFill fill;
+  Dwarf_Die die;
+  GArray *rows;
+  guint next_row;
+} AttrRefresh;
+
+
+static void
+attr_refresh_cancel (AttrRefresh *refresh)
+{
+  if (refresh->fill_id == 0)
+    return;
+
+  g_source_remove (refresh->fill_id);
+  refresh->fill_id = 0;
+  g_hash_table_destroy (refresh->fill.open);
+  g_object_unref (refresh->fill.store);
+}
+
+
+static gboolean
+attr_refresh_step (gpointer data)
+{
+  AttrRefresh *refresh = data;
+  AttrFill *fill = &refresh->fill;
+  gint64 start = profile_begin ();
+  gint64 deadline = g_get_monotonic_time () + ATTR_TREE_FILL_BUDGET_US;
+
+  while (refresh->next_row < refresh->rows->len)
+    {
+      AttrRow *row = &g_array_index (refresh->rows, AttrRow,
+                                     refresh->next_row++);
+      attr_tree_fill_row (fill, row, NULL, fill->session->attr_depth);
+      if (g_get_monotonic_time () >= deadline)
         {
-          AttrCallback cbdata = *data;
-          cbdata.die = &ref;
-          cbdata.parent = &data->iter;
-          cbdata.sibling = NULL;
-          cbdata.back = data;
-          dwarf_getattrs (&ref, getattrs_callback, &cbdata, 0);
+          profile_end (start, "attr rows");
+          return G_SOURCE_CONTINUE;
         }
     }
+  profile_end (start, "attr rows");
 
-  data->sibling = &data->iter;
-  return DWARF_CB_OK;
+  gtk_tree_view_set_model (refresh->view, GTK_TREE_MODEL (fill->store));
+  refresh->fill_id = 0;
+  g_hash_table_destroy (fill->open);
+  g_object_unref (fill->store);
+  return G_SOURCE_REMOVE;
+}
+
+
+static gboolean
+attr_refresh_start (gpointer data)
+{
+  AttrRefresh *refresh = data;
+  refresh->debounce_id = 0;
+
+  GtkTreeIter iter;
+  GtkTreeModel *model;
+  DwarvishSession *session;
+  if (!gtk_tree_selection_get_selected (refresh->selection, &model, &iter)
+      || !die_tree_get_die (model, &iter, &refresh->die))
+    {
+      session = g_object_get_data (G_OBJECT (model), "DwarvishSession");
+      GtkTreeStore *store = attr_tree_store_new (session);
+      gtk_tree_view_set_model (refresh->view, GTK_TREE_MODEL (store));
+      g_object_unref (store);
+      return G_SOURCE_REMOVE;
+    }
+
+  session = g_object_get_data (G_OBJECT (model), "DwarvishSession");
+  attr_tree_fill_init (&refresh->fill, attr_tree_store_new (session));
+  refresh->rows = attr_tree_get_rows (&refresh->fill, &refresh->die);
+  refresh->next_row = 0;
+  g_hash_table_add (refresh->fill.open, refresh->die.addr);
+
+  /* The first step runs now, which is usually all it takes.  */
+  if (attr_refresh_step (refresh))
+    refresh->fill_id = g_idle_add (attr_refresh_step, refresh);
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+attr_refresh_free (gpointer data)
+{
+  AttrRefresh *refresh = data;
+  attr_refresh_cancel (refresh);
+  if (refresh->debounce_id != 0)
+    g_source_remove (refresh->debounce_id);
+  g_object_unref (refresh->selection);
+  g_slice_free (AttrRefresh, refresh);
 }
 
 
@@ -292,28 +571,65 @@ signal_die_tree_selection_changed (GtkTreeSelection *selection,
                                    gpointer user_data)
 {
   GtkTreeView *view = GTK_TREE_VIEW (user_data);
-  GtkTreeStore *store = GTK_TREE_STORE (gtk_tree_view_get_model (view));
-  gtk_tree_store_clear (store);
+  AttrRefresh *refresh = g_object_get_data (G_OBJECT (view), "AttrRefresh");
+  if (refresh == NULL)
+    {
+      refresh = g_slice_new0 (AttrRefresh);
+      refresh->view = view;
+      refresh->selection = g_object_ref (selection);
+      g_object_set_data_full (G_OBJECT (view), "AttrRefresh",
+                              refresh, attr_refresh_free);
+    }
 
-  Dwarf_Die die;
-  GtkTreeIter iter;
-  GtkTreeModel *model;
-  if (!gtk_tree_selection_get_selected (selection, &model, &iter)
-      || !die_tree_get_die (model, &iter, &die))
-    return;
+  attr_refresh_cancel (refresh);
+  if (refresh->debounce_id != 0)
+    g_source_remove (refresh->debounce_id);
+  refresh->debounce_id = g_timeout_add (ATTR_TREE_DEBOUNCE_MS,
+                                        attr_refresh_start, refresh);
+}
+
+
+/* Referenced DIEs are only listed up to the prefetch depth, so fill in the
+ * rest as their rows are expanded.  */
+G_MODULE_EXPORT gboolean
+signal_attr_tree_test_expand_row (GtkTreeView *tree_view, GtkTreeIter *iter,
+                                  G_GNUC_UNUSED GtkTreePath *path,
+                                  G_GNUC_UNUSED gpointer user_data)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model (tree_view);
+  GtkTreeStore *store = GTK_TREE_STORE (model);
+
+  GtkTreeIter child;
+  if (!gtk_tree_model_iter_children (model, &child, iter))
+    return FALSE;
+  if (attr_tree_get_row (model, &child) != NULL)
+    return FALSE; /* Already filled.  */
+  gtk_tree_store_remove (store, &child);
+
+  AttrRow *row = attr_tree_get_row (model, iter);
+  if (row == NULL || !row->has_ref)
+    return TRUE;
+
+  /* The DIEs of this row and those above are open, to avoid cycles.  */
+  AttrFill fill;
+  attr_tree_fill_init (&fill, store);
+  GtkTreeIter above = *iter, parent;
+  for (;;)
+    {
+      AttrRow *open = attr_tree_get_row (model, &above);
+      if (open != NULL)
+        g_hash_table_add (fill.open, open->die_addr);
+
+      if (!gtk_tree_model_iter_parent (model, &parent, &above))
+        break;
+      above = parent;
+    }
+
+  attr_tree_fill (&fill, &row->ref, iter, fill.session->attr_depth);
+  g_hash_table_destroy (fill.open);
 
-  DwarvishSession *session = g_object_get_data (G_OBJECT (model),
-                                                "DwarvishSession");
-
-  AttrCallback cbdata;
-  cbdata.explicit_siblings = session->explicit_siblings;
-  cbdata.die = &die;
-  cbdata.store = store;
-  cbdata.parent = NULL;
-  cbdata.sibling = NULL;
-  cbdata.back = NULL;
-  dwarf_getattrs (&die, getattrs_callback, &cbdata, 0);
-  gtk_tree_view_expand_all (view);
+  /* Don't expand if that turned out empty after all.  */
+  return !gtk_tree_model_iter_has_child (model, iter);
 }
 
 
@@ -332,13 +648,12 @@ signal_attr_tree_query_tooltip (GtkWidget *widget,
                                           &model, &path, &iter))
     return FALSE;
 
-  gchar *value = NULL;
-  gtk_tree_model_get (model, &iter, ATTR_TREE_COL_VALUE, &value, -1);
+  AttrRow *row = attr_tree_get_row (model, &iter);
+  const gchar *value = row ? row->value : NULL;
   if (value != NULL)
     {
       gtk_tooltip_set_text (tooltip, value);
       gtk_tree_view_set_tooltip_row (view, tooltip, path);
-      g_free (value);
     }
 
   gtk_tree_path_free (path);
@@ -347,6 +662,30 @@ signal_attr_tree_query_tooltip (GtkWidget *widget,
 }
 
 
+/* Names are static strings and values are already rendered in the row
+ * cache, so only the rows being drawn hand any text to the renderer.  */
+static void
+attr_tree_cell_data (G_GNUC_UNUSED GtkTreeViewColumn *col,
+                     GtkCellRenderer *renderer, GtkTreeModel *model,
+                     GtkTreeIter *iter, gpointer data)
+{
+  gint column = GPOINTER_TO_INT (data);
+  AttrRow *row = attr_tree_get_row (model, iter);
+
+  const char *text = NULL;
+  if (row != NULL && column == ATTR_TREE_COL_VALUE)
+    text = row->value;
+  else if (row != NULL)
+    {
+      gint code;
+      gtk_tree_model_get (model, iter, column, &code, -1);
+      text = (column == ATTR_TREE_COL_ATTRIBUTE
+              ? DW_AT__name (code) : DW_FORM__name (code));
+    }
+  g_object_set (renderer, "text", text, NULL);
+}
+
+
 static void
 attr_tree_render_column (GtkTreeView *view, gint column)
 {
@@ -357,21 +696,15 @@ attr_tree_render_column (GtkTreeView *view, gint column)
     g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
 
   gtk_tree_view_column_pack_start (col, renderer, TRUE);
-  gtk_tree_view_column_add_attribute (col, renderer, "text", column);
+  gtk_tree_view_column_set_cell_data_func (col, renderer, attr_tree_cell_data,
+                                           GINT_TO_POINTER (column), NULL);
 }
 
 
 gboolean
 attr_tree_view_render (GtkTreeView *attrtree, DwarvishSession *session)
 {
-  GtkTreeStore *store = gtk_tree_store_new (ATTR_TREE_N_COLUMNS,
-                                            G_TYPE_STRING,
-                                            G_TYPE_STRING,
-                                            G_TYPE_STRING,
-                                            G_TYPE_DWARF_DIE,
-                                            G_TYPE_DWARF_ATTR);
-  g_object_set_data (G_OBJECT (store), "DwarvishSession", session);
-
+  GtkTreeStore *store = attr_tree_store_new (session);
   gtk_tree_view_set_model (attrtree, GTK_TREE_MODEL (store));
   g_object_unref (store); /* The view keeps its own reference.  */
 
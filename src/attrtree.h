@@ -21,11 +21,20 @@ G_GNUC_INTERNAL
 gboolean attr_tree_view_render (GtkTreeView *attrtree,
                                 DwarvishSession *session);
 
+G_GNUC_INTERNAL
+GtkTreeModel *attr_tree_model_new (DwarvishSession *session,
+                                   Dwarf_Die *die);
+
 G_GNUC_INTERNAL
 gboolean attr_tree_get_attribute (GtkTreeModel *model,
                                   GtkTreeIter *iter,
                                   Dwarf_Attribute *attr);
 
+G_GNUC_INTERNAL
+char *attr_tree_value_string (DwarvishSession *session,
+                              Dwarf_Die *die,
+                              Dwarf_Attribute *attr);
+
 
 #endif /* _ATTRTREE_H_ */
 
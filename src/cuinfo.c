@@ -0,0 +1,133 @@
+/*
+ * Compile unit metadata implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <dwarf.h>
+#include "cuinfo.h"
+
+
+static void
+cu_info_destroy (gpointer data)
+{
+  g_slice_free (CuInfo, data);
+}
+
+
+/* Read the rest of the unit header, which libdw can give from the CU
+ * itself from 0.171, whichever section it came from.  Before that, type
+ * units only came from .debug_types, which needs a signature pointer to
+ * make dwarf_next_unit read that section.  */
+static void
+cu_info_read_header (CuInfo *info)
+{
+  Dwarf_Half version;
+  uint64_t unit_id = 0;
+
+#ifdef HAVE_DWARF_CU_INFO
+  uint8_t unit_type;
+  if (dwarf_cu_info (info->die.cu, &version, &unit_type, NULL, NULL,
+                     &unit_id, NULL, NULL) != 0)
+    return;
+  info->unit_type = unit_type;
+#else
+  Dwarf_Off noff;
+  size_t cuhl;
+  if (dwarf_next_unit (dwarf_cu_getdwarf (info->die.cu), info->offset,
+                       &noff, &cuhl, &version, NULL, NULL, NULL,
+                       info->tag == DW_TAG_type_unit ? &unit_id : NULL,
+                       NULL) != 0)
+    return;
+#endif
+
+  info->have_header = TRUE;
+  info->version = version;
+  info->unit_id = unit_id;
+}
+
+
+static CuInfo *
+cu_info_new (Dwarf_Die *die)
+{
+  CuInfo *info = g_slice_new0 (CuInfo);
+  if (dwarf_diecu (die, &info->die, &info->address_size,
+                   &info->offset_size) == NULL)
+    {
+      g_slice_free (CuInfo, info);
+      return NULL;
+    }
+
+  info->tag = dwarf_tag (&info->die);
+  info->offset = dwarf_dieoffset (&info->die) - dwarf_cuoffset (&info->die);
+
+  Dwarf_Attribute attr;
+  if (dwarf_attr (&info->die, DW_AT_language, &attr) == NULL
+      || dwarf_formudata (&attr, &info->language) != 0)
+    info->language = 0;
+
+  cu_info_read_header (info);
+  return info;
+}
+
+
+/* Get the metadata for the unit containing a DIE, computed once per unit.
+ * Units are keyed by their Dwarf_CU, so a lookup is just a hash of the
+ * DIE's own cu pointer, without even calling dwarf_diecu.  */
+CuInfo *
+cu_info_lookup (DwarvishSession *session, Dwarf_Die *die)
+{
+  if (session->cu_infos == NULL)
+    session->cu_infos = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL, cu_info_destroy);
+
+  CuInfo *info = g_hash_table_lookup (session->cu_infos, die->cu);
+  if (info == NULL)
+    {
+      info = cu_info_new (die);
+      if (info != NULL)
+        g_hash_table_insert (session->cu_infos, die->cu, info);
+    }
+  return info;
+}
+
+
+/* Like dwarf_decl_file for an already known DW_AT_decl_file.  This might be
+ * a bit paranoid, but it's more directly showing what's specified.  */
+const char *
+cu_info_file (DwarvishSession *session, Dwarf_Die *die, size_t idx)
+{
+  CuInfo *info = cu_info_lookup (session, die);
+  if (info == NULL)
+    return NULL;
+
+  if (!info->have_files)
+    {
+      info->have_files = TRUE;
+      if (dwarf_getsrcfiles (&info->die, &info->files, &info->nfiles) != 0)
+        info->files = NULL;
+    }
+
+  if (info->files == NULL || idx >= info->nfiles)
+    return NULL;
+  return dwarf_filesrc (info->files, idx, NULL, NULL);
+}
+
+
+void
+cu_info_free (DwarvishSession *session)
+{
+  if (session->cu_infos != NULL)
+    g_hash_table_destroy (session->cu_infos);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,58 @@
+/*
+ * Compile unit metadata interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _CUINFO_H_
+#define _CUINFO_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+typedef struct _CuInfo
+{
+  Dwarf_Die die;                /* The unit DIE.  */
+  Dwarf_Off offset;             /* Offset of the unit header.  */
+  int tag;                      /* compile, partial, or type unit.  */
+  Dwarf_Word language;          /* DW_LANG_*, or 0 if unknown.  */
+  uint8_t address_size;
+  uint8_t offset_size;
+
+  /* The rest of the header is only set if it could be read.  */
+  gboolean have_header;
+  Dwarf_Half version;
+  uint8_t unit_type;            /* DW_UT_*, or 0 before libdw 0.171.  */
+  uint64_t unit_id;             /* Type signature or split unit id.  */
+
+  /* Source files are only read when first needed.  */
+  gboolean have_files;
+  Dwarf_Files *files;
+  size_t nfiles;
+} CuInfo;
+
+
+G_GNUC_INTERNAL
+CuInfo *cu_info_lookup (DwarvishSession *session,
+                        Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+const char *cu_info_file (DwarvishSession *session,
+                          Dwarf_Die *die,
+                          size_t idx);
+
+G_GNUC_INTERNAL
+void cu_info_free (DwarvishSession *session);
+
+
+#endif /* _CUINFO_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
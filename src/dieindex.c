@@ -0,0 +1,229 @@
+/*
+ * DIE index implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <dwarf.h>
+#include "dieindex.h"
+#include "indexcache.h"
+
+
+/* Each unit gets an array of its DIEs with their parents, built on first
+ * use.  A depth-first walk visits DIEs in offset order, so the array is
+ * already sorted for binary searching.  This matches IndexCacheParent.  */
+typedef struct _DieParent
+{
+  Dwarf_Off offset;
+  Dwarf_Off parent;
+} DieParent;
+
+
+static void
+die_parents_free (gpointer data)
+{
+  g_array_free (data, TRUE);
+}
+
+
+static void
+die_index_walk (GArray *parents, Dwarf_Die *die, Dwarf_Off parent)
+{
+  DieParent entry = { dwarf_dieoffset (die), parent };
+  g_array_append_val (parents, entry);
+
+  Dwarf_Die child;
+  if (dwarf_child (die, &child) == 0)
+    do
+      die_index_walk (parents, &child, entry.offset);
+    while (dwarf_siblingof (&child, &child) == 0);
+}
+
+
+static GArray *
+die_index_unit_parents (DwarvishSession *session, Dwarf_Die *unit)
+{
+  if (session->die_parents == NULL)
+    session->die_parents = g_hash_table_new_full (g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL, die_parents_free);
+
+  GArray *parents = g_hash_table_lookup (session->die_parents, unit->cu);
+  if (parents == NULL)
+    {
+      parents = g_array_new (FALSE, FALSE, sizeof (DieParent));
+      die_index_walk (parents, unit, dwarf_dieoffset (unit));
+      g_hash_table_insert (session->die_parents, unit->cu, parents);
+    }
+  return parents;
+}
+
+
+static int
+die_parent_compare (const void *a, const void *b)
+{
+  Dwarf_Off offset = *(const Dwarf_Off *) a;
+  const DieParent *entry = b;
+  return (offset > entry->offset) - (offset < entry->offset);
+}
+
+
+/* Find the parent of a DIE, returning FALSE if it's a unit DIE.  */
+gboolean
+die_index_get_parent (DwarvishSession *session, Dwarf_Die *die,
+                      gboolean types, Dwarf_Die *parent)
+{
+  Dwarf_Die unit;
+  if (dwarf_diecu (die, &unit, NULL, NULL) == NULL)
+    return FALSE;
+
+  Dwarf_Off offset = dwarf_dieoffset (die);
+  if (offset == dwarf_dieoffset (&unit))
+    return FALSE;
+
+  /* The cache covers the whole main .debug_info, in the same layout.  */
+  gsize count = 0;
+  const DieParent *array = NULL;
+  Dwarf *dwarf = dwarf_cu_getdwarf (die->cu);
+  if (!types && dwarf == session->dwarf)
+    array = index_cache_section (session->index_caches[FALSE],
+                                 INDEX_CACHE_PARENTS, &count);
+  if (array == NULL)
+    {
+      GArray *parents = die_index_unit_parents (session, &unit);
+      array = (const DieParent *) parents->data;
+      count = parents->len;
+    }
+
+  const DieParent *entry = bsearch (&offset, array, count,
+                                    sizeof (DieParent), die_parent_compare);
+  if (entry == NULL)
+    return FALSE;
+
+  if (types)
+    return dwarf_offdie_types (dwarf, entry->parent, parent) != NULL;
+  return dwarf_offdie (dwarf, entry->parent, parent) != NULL;
+}
+
+
+static void
+die_importers_free (gpointer data)
+{
+  g_array_free (data, TRUE);
+}
+
+
+/* Record the imported_unit DIEs at the top of this unit, and recurse into
+ * the units they import.  */
+static void
+die_index_scan_imports (GHashTable *importers, GHashTable *scanned,
+                        Dwarf_Die *unit)
+{
+  if (g_hash_table_contains (scanned, unit->cu))
+    return;
+  g_hash_table_add (scanned, unit->cu);
+
+  Dwarf_Die child;
+  if (dwarf_child (unit, &child) == 0)
+    do
+      {
+        Dwarf_Die import;
+        Dwarf_Attribute attr;
+        if (dwarf_tag (&child) != DW_TAG_imported_unit
+            || dwarf_attr (&child, DW_AT_import, &attr) == NULL
+            || dwarf_formref_die (&attr, &import) == NULL)
+          continue;
+
+        GArray *array = g_hash_table_lookup (importers, import.cu);
+        if (array == NULL)
+          {
+            array = g_array_new (FALSE, FALSE, sizeof (Dwarf_Die));
+            g_hash_table_insert (importers, import.cu, array);
+          }
+        g_array_append_val (array, child);
+
+        die_index_scan_imports (importers, scanned, &import);
+      }
+    while (dwarf_siblingof (&child, &child) == 0);
+}
+
+
+static GHashTable *
+die_index_importers (DwarvishSession *session)
+{
+  if (session->die_importers != NULL)
+    return session->die_importers;
+
+  GHashTable *importers = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 NULL, die_importers_free);
+  GHashTable *scanned = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  size_t cuhl;
+  for (Dwarf_Off noff, off = 0;
+       dwarf_next_unit (session->dwarf, off, &noff, &cuhl, NULL,
+                        NULL, NULL, NULL, NULL, NULL) == 0;
+       off = noff)
+    {
+      Dwarf_Die unit;
+      if (dwarf_offdie (session->dwarf, off + cuhl, &unit) != NULL)
+        die_index_scan_imports (importers, scanned, &unit);
+    }
+
+  g_hash_table_destroy (scanned);
+  return session->die_importers = importers;
+}
+
+
+/* Find an imported_unit DIE which imports the given partial unit.  One from
+ * the hint's unit is preferred, then any directly in a compile unit.  */
+gboolean
+die_index_get_importer (DwarvishSession *session, Dwarf_Die *unit,
+                        Dwarf_Die *hint, Dwarf_Die *importer)
+{
+  GArray *array = g_hash_table_lookup (die_index_importers (session),
+                                       unit->cu);
+  if (array == NULL || array->len == 0)
+    return FALSE;
+
+  Dwarf_Die *best = NULL;
+  for (guint i = 0; i < array->len; ++i)
+    {
+      Dwarf_Die *die = &g_array_index (array, Dwarf_Die, i);
+      if (hint != NULL && die->cu == hint->cu)
+        {
+          best = die;
+          break;
+        }
+
+      Dwarf_Die cu;
+      if (best == NULL && dwarf_diecu (die, &cu, NULL, NULL) != NULL
+          && dwarf_tag (&cu) != DW_TAG_partial_unit)
+        best = die;
+    }
+
+  *importer = *(best ?: &g_array_index (array, Dwarf_Die, 0));
+  return TRUE;
+}
+
+
+void
+die_index_free (DwarvishSession *session)
+{
+  if (session->die_parents != NULL)
+    g_hash_table_destroy (session->die_parents);
+  if (session->die_importers != NULL)
+    g_hash_table_destroy (session->die_importers);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
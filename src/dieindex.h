@@ -0,0 +1,39 @@
+/*
+ * DIE index interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _DIEINDEX_H_
+#define _DIEINDEX_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+G_GNUC_INTERNAL
+gboolean die_index_get_parent (DwarvishSession *session,
+                               Dwarf_Die *die,
+                               gboolean types,
+                               Dwarf_Die *parent);
+
+G_GNUC_INTERNAL
+gboolean die_index_get_importer (DwarvishSession *session,
+                                 Dwarf_Die *unit,
+                                 Dwarf_Die *hint,
+                                 Dwarf_Die *importer);
+
+G_GNUC_INTERNAL
+void die_index_free (DwarvishSession *session);
+
+
+#endif /* _DIEINDEX_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
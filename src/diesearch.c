@@ -0,0 +1,352 @@
+/*
+ * DIE search entry implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+#include "diesearch.h"
+#include "addrindex.h"
+#include "dietree.h"
+#include "dwstring.h"
+#include "nameindex.h"
+
+
+/* The matches are offered through the entry's completion popup, so they
+ * only need to be enough to pick from.  */
+#define DIE_SEARCH_LIMIT 200
+#define DIE_SEARCH_MIN_LENGTH 2
+#define DIE_SEARCH_POLL_MS 100
+
+enum
+{
+  DIE_SEARCH_COL_NAME = 0,
+  DIE_SEARCH_COL_TAG,
+  DIE_SEARCH_COL_MATCH,
+  DIE_SEARCH_N_COLUMNS
+};
+
+typedef struct _DieSearch
+{
+  GtkEntry *entry;
+  GtkTreeView *view;
+  DwarvishSession *session;
+  gboolean types;
+
+  NameIndex *index;
+  GArray *matches;      /* NameEntry, as listed in the completion.  */
+  guint source_id;      /* Polling while the index is built.  */
+} DieSearch;
+
+typedef struct _DieAddress
+{
+  GtkEntry *entry;
+  GtkTreeView *view;
+  DwarvishSession *session;
+
+  AddrIndex *index;
+  guint source_id;      /* Polling while the index is built.  */
+} DieAddress;
+
+
+static void
+die_search_goto (DieSearch *search, guint match)
+{
+  Dwarf_Die die;
+  if (match < search->matches->len
+      && name_index_get_die (search->index,
+                             &g_array_index (search->matches,
+                                             NameEntry, match),
+                             &die))
+    {
+      die_tree_view_goto_die (search->view, &die);
+      gtk_widget_grab_focus (GTK_WIDGET (search->view));
+    }
+}
+
+
+static GtkListStore *
+die_search_list_matches (DieSearch *search)
+{
+  GtkListStore *store = gtk_list_store_new (DIE_SEARCH_N_COLUMNS,
+                                            G_TYPE_STRING, G_TYPE_STRING,
+                                            G_TYPE_UINT);
+
+  for (guint i = 0; i < search->matches->len; ++i)
+    {
+      NameEntry *entry = &g_array_index (search->matches, NameEntry, i);
+
+      Dwarf_Die die;
+      const char *tag = NULL;
+      if (name_index_get_die (search->index, entry, &die))
+        tag = DW_TAG__name (dwarf_tag (&die));
+
+      GtkTreeIter iter;
+      gtk_list_store_append (store, &iter);
+      gtk_list_store_set (store, &iter,
+                          DIE_SEARCH_COL_NAME,
+                          name_index_entry_name (search->index, entry),
+                          DIE_SEARCH_COL_TAG, tag ?: "",
+                          DIE_SEARCH_COL_MATCH, i,
+                          -1);
+    }
+
+  return store;
+}
+
+
+static gboolean
+die_search_poll (gpointer data)
+{
+  DieSearch *search = data;
+  if (!name_index_ready (search->index))
+    {
+      gtk_entry_progress_pulse (search->entry);
+      return G_SOURCE_CONTINUE;
+    }
+
+  /* Now search again for whatever has been typed meanwhile.  */
+  search->source_id = 0;
+  gtk_entry_set_progress_fraction (search->entry, 0.0);
+  g_signal_emit_by_name (search->entry, "changed");
+  return G_SOURCE_REMOVE;
+}
+
+
+/* Refresh the completion model before the completion itself sees the
+ * change, so its popup shows the new matches.  */
+static void
+signal_die_search_changed (GtkEditable *editable, gpointer user_data)
+{
+  DieSearch *search = user_data;
+  GtkEntryCompletion *completion =
+    gtk_entry_get_completion (GTK_ENTRY (editable));
+  const gchar *text = gtk_entry_get_text (search->entry);
+
+  g_array_set_size (search->matches, 0);
+  if (strlen (text) >= DIE_SEARCH_MIN_LENGTH)
+    {
+      /* The index is built on first use.  */
+      if (search->index == NULL)
+        search->index = name_index_get (search->session, search->types);
+
+      if (name_index_ready (search->index))
+        name_index_search (search->index, text, DIE_SEARCH_LIMIT,
+                           search->matches);
+      else if (search->source_id == 0)
+        search->source_id = g_timeout_add (DIE_SEARCH_POLL_MS,
+                                           die_search_poll, search);
+    }
+
+  GtkListStore *store = die_search_list_matches (search);
+  gtk_entry_completion_set_model (completion, GTK_TREE_MODEL (store));
+  g_object_unref (store);
+}
+
+
+static void
+signal_die_search_activate (G_GNUC_UNUSED GtkEntry *entry,
+                            gpointer user_data)
+{
+  die_search_goto (user_data, 0);
+}
+
+
+static gboolean
+signal_die_search_match_selected (G_GNUC_UNUSED GtkEntryCompletion *completion,
+                                  GtkTreeModel *model, GtkTreeIter *iter,
+                                  gpointer user_data)
+{
+  guint match;
+  gtk_tree_model_get (model, iter, DIE_SEARCH_COL_MATCH, &match, -1);
+  die_search_goto (user_data, match);
+  return TRUE;
+}
+
+
+/* Everything listed has already matched.  */
+static gboolean
+die_search_match_func (G_GNUC_UNUSED GtkEntryCompletion *completion,
+                       G_GNUC_UNUSED const gchar *key,
+                       G_GNUC_UNUSED GtkTreeIter *iter,
+                       G_GNUC_UNUSED gpointer user_data)
+{
+  return TRUE;
+}
+
+
+static void
+die_search_free (gpointer data)
+{
+  DieSearch *search = data;
+  if (search->source_id != 0)
+    g_source_remove (search->source_id);
+  g_array_free (search->matches, TRUE);
+  g_slice_free (DieSearch, search);
+}
+
+
+void
+die_search_entry_setup (GtkEntry *entry, GtkTreeView *view,
+                        DwarvishSession *session, gboolean types)
+{
+  DieSearch *search = g_slice_new0 (DieSearch);
+  search->entry = entry;
+  search->view = view;
+  search->session = session;
+  search->types = types;
+  search->matches = g_array_new (FALSE, FALSE, sizeof (NameEntry));
+  g_object_set_data_full (G_OBJECT (entry), "DieSearch",
+                          search, die_search_free);
+
+  GtkEntryCompletion *completion = gtk_entry_completion_new ();
+  gtk_entry_completion_set_match_func (completion, die_search_match_func,
+                                       NULL, NULL);
+  gtk_entry_completion_set_minimum_key_length (completion,
+                                               DIE_SEARCH_MIN_LENGTH);
+  gtk_entry_completion_set_text_column (completion, DIE_SEARCH_COL_NAME);
+
+  GtkCellRenderer *cell = gtk_cell_renderer_text_new ();
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (completion), cell, FALSE);
+  gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (completion), cell,
+                                 "text", DIE_SEARCH_COL_TAG);
+
+  g_signal_connect (completion, "match-selected",
+                    G_CALLBACK (signal_die_search_match_selected), search);
+  g_signal_connect (entry, "activate",
+                    G_CALLBACK (signal_die_search_activate), search);
+
+  /* This must be connected before the completion is attached.  */
+  g_signal_connect (entry, "changed",
+                    G_CALLBACK (signal_die_search_changed), search);
+  gtk_entry_set_completion (entry, completion);
+  g_object_unref (completion);
+}
+
+
+static void
+die_address_set_error (DieAddress *address, const gchar *error)
+{
+  gtk_entry_set_icon_from_stock (address->entry, GTK_ENTRY_ICON_SECONDARY,
+                                 error ? GTK_STOCK_DIALOG_WARNING : NULL);
+  gtk_entry_set_icon_tooltip_text (address->entry, GTK_ENTRY_ICON_SECONDARY,
+                                   error);
+}
+
+
+/* Go to the innermost DIE with the address, as hex with an optional 0x.  */
+static void
+die_address_goto (DieAddress *address)
+{
+  const gchar *text = gtk_entry_get_text (address->entry);
+  while (g_ascii_isspace (*text))
+    ++text;
+  if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    text += 2;
+
+  gchar *end;
+  Dwarf_Addr pc = g_ascii_strtoull (text, &end, 16);
+  while (g_ascii_isspace (*end))
+    ++end;
+  if (end == text || *end != '\0')
+    {
+      die_address_set_error (address, "Not a hexadecimal address");
+      return;
+    }
+
+  Dwarf_Die die;
+  if (!addr_index_lookup (address->index, pc, &die))
+    {
+      die_address_set_error (address, "No DIE covers this address");
+      return;
+    }
+
+  die_address_set_error (address, NULL);
+  die_tree_view_goto_die (address->view, &die);
+  gtk_widget_grab_focus (GTK_WIDGET (address->view));
+}
+
+
+static gboolean
+die_address_poll (gpointer data)
+{
+  DieAddress *address = data;
+  if (!addr_index_ready (address->index))
+    {
+      gtk_entry_progress_pulse (address->entry);
+      return G_SOURCE_CONTINUE;
+    }
+
+  address->source_id = 0;
+  gtk_entry_set_progress_fraction (address->entry, 0.0);
+  die_address_goto (address);
+  return G_SOURCE_REMOVE;
+}
+
+
+/* The index is started as soon as an address is typed, so it's likely
+ * ready by the time it's entered.  */
+static void
+signal_die_address_changed (G_GNUC_UNUSED GtkEditable *editable,
+                            gpointer user_data)
+{
+  DieAddress *address = user_data;
+  if (address->index == NULL)
+    address->index = addr_index_get (address->session);
+  die_address_set_error (address, NULL);
+}
+
+
+static void
+signal_die_address_activate (G_GNUC_UNUSED GtkEntry *entry,
+                             gpointer user_data)
+{
+  DieAddress *address = user_data;
+  if (address->index == NULL)
+    address->index = addr_index_get (address->session);
+
+  if (addr_index_ready (address->index))
+    die_address_goto (address);
+  else if (address->source_id == 0)
+    address->source_id = g_timeout_add (DIE_SEARCH_POLL_MS,
+                                        die_address_poll, address);
+}
+
+
+static void
+die_address_free (gpointer data)
+{
+  DieAddress *address = data;
+  if (address->source_id != 0)
+    g_source_remove (address->source_id);
+  g_slice_free (DieAddress, address);
+}
+
+
+void
+die_address_entry_setup (GtkEntry *entry, GtkTreeView *view,
+                         DwarvishSession *session)
+{
+  DieAddress *address = g_slice_new0 (DieAddress);
+  address->entry = entry;
+  address->view = view;
+  address->session = session;
+  g_object_set_data_full (G_OBJECT (entry), "DieAddress",
+                          address, die_address_free);
+
+  g_signal_connect (entry, "changed",
+                    G_CALLBACK (signal_die_address_changed), address);
+  g_signal_connect (entry, "activate",
+                    G_CALLBACK (signal_die_address_activate), address);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
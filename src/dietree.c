@@ -14,21 +14,15 @@
 
 #include <dwarf.h>
 #include "dietree.h"
-#include "attrtree.h"
+#include "dietreemodel.h"
 #include "dwstring.h"
+#include "attrtree.h"
+#include "indexcache.h"
+#include "profile.h"
+#include "sigindex.h"
 #include "util.h"
 
 
-enum
-{
-  DIE_TREE_COL_OFFSET = 0,
-  DIE_TREE_COL_TAG,
-  DIE_TREE_COL_NAME,
-  DIE_TREE_INT_DIE,
-  DIE_TREE_N_COLUMNS
-};
-
-
 static G_DEFINE_SLICED_COPY (Dwarf_Die, dwarf_die);
 static G_DEFINE_SLICED_FREE (Dwarf_Die, dwarf_die);
 G_DEFINE_SLICED_BOXED_TYPE (Dwarf_Die, dwarf_die);
@@ -38,283 +32,15 @@ gboolean
 die_tree_get_die (GtkTreeModel *model, GtkTreeIter *iter,
                   Dwarf_Die *die_mem)
 {
-  Dwarf_Die *die = NULL;
-  gtk_tree_model_get (model, iter, DIE_TREE_INT_DIE, &die, -1);
-  if (die == NULL)
-    return FALSE;
-  *die_mem = *die;
-  dwarf_die_free (die);
-  return TRUE;
-}
-
-
-static GString *
-dwarf_die_typename_part (Dwarf_Die *die, Dwarf_Die *subroutine)
-{
-  const char *prepend = NULL, *append = NULL;
-  switch (dwarf_tag (die))
-    {
-    case DW_TAG_base_type:
-    case DW_TAG_typedef:
-      return g_string_new (dwarf_diename (die));
-
-    case DW_TAG_class_type:
-      prepend = "class ";
-      break;
-    case DW_TAG_enumeration_type:
-      prepend = "enum ";
-      break;
-    case DW_TAG_structure_type:
-      prepend = "struct ";
-      break;
-    case DW_TAG_union_type:
-      prepend = "union ";
-      break;
-
-    case DW_TAG_array_type:
-      append = "[]";
-      break;
-    case DW_TAG_const_type:
-      append = " const";
-      break;
-    case DW_TAG_pointer_type:
-      append = "*";
-      break;
-    case DW_TAG_reference_type:
-      append = "&";
-      break;
-    case DW_TAG_rvalue_reference_type:
-      append = "&&";
-      break;
-    case DW_TAG_volatile_type:
-      append = " volatile";
-      break;
-
-    case DW_TAG_subroutine_type:
-      /* Subroutine types (function pointers) are a weird case.  The modifiers
-       * we've recursed so far need to go in the middle, with the return type
-       * on the left and parameter types on the right.  We'll back out now to
-       * get those modifiers, getting the return and parameters separately.  */
-      *subroutine = *die;
-      return g_string_new ("");
-
-    default:
-      return NULL;
-    }
-
-  GString *string = NULL;
-  if (prepend != NULL)
-    {
-      GString *string = g_string_new (prepend);
-      return g_string_append (string, dwarf_diename (die) ?: "{...}");
-    }
-
-  Dwarf_Die type;
-  Dwarf_Attribute attr;
-  if (dwarf_attr (die, DW_AT_type, &attr) == NULL)
-    string = g_string_new ("void");
-  else if (dwarf_formref_die (&attr, &type) != NULL)
-    string = dwarf_die_typename_part (&type, subroutine);
-
-  if (string == NULL)
-    return NULL;
-
-  if (append != NULL)
-    g_string_append (string, append);
-
-  return string;
-}
-
-
-static GString *
-dwarf_die_typename (Dwarf_Die *die)
-{
-  Dwarf_Die subroutine;
-  subroutine.addr = 0;
-
-  GString *string = dwarf_die_typename_part (die, &subroutine);
-  if (string == NULL || subroutine.addr == 0)
-    return string;
-
-  /* Subroutine types need special handling.  First add the return value.  */
-  GString *retval;
-  Dwarf_Die type;
-  Dwarf_Attribute attr;
-  g_string_prepend (string, " (");
-  if (dwarf_attr (&subroutine, DW_AT_type, &attr) == NULL)
-    g_string_prepend (string, "void");
-  else if (dwarf_formref_die (&attr, &type) != NULL &&
-           (retval = dwarf_die_typename (&type)) != NULL)
-    {
-      g_string_prepend (string, retval->str);
-      g_string_free (retval, TRUE);
-    }
-  else
-    g_string_prepend (string, "?");
-  g_string_append (string, ")");
-
-  /* Now parameters.  */
-  gboolean first = TRUE;
-  g_string_append (string, " (");
-  Dwarf_Die child;
-  if (dwarf_child (&subroutine, &child) == 0)
-    do
-      if (dwarf_tag (&child) == DW_TAG_formal_parameter)
-        {
-          if (!first)
-            g_string_append (string, ", ");
-          else
-            first = FALSE;
-
-          GString *param;
-          if (dwarf_attr (&child, DW_AT_type, &attr) == NULL)
-            g_string_append (string, "void");
-          else if (dwarf_formref_die (&attr, &type) != NULL &&
-                   (param = dwarf_die_typename (&type)) != NULL)
-            {
-              g_string_append (string, param->str);
-              g_string_free (param, TRUE);
-            }
-          else
-            g_string_append (string, "?");
-        }
-      else if (dwarf_tag (&child) == DW_TAG_unspecified_parameters)
-        {
-          if (!first)
-            g_string_append (string, ", ");
-          else
-            first = FALSE;
-          g_string_append (string, "...");
-        }
-    while (dwarf_siblingof (&child, &child) == 0);
-  if (first)
-    g_string_append (string, "void");
-  return g_string_append (string, ")");
-}
-
-
-static void
-die_tree_set_die (GtkTreeStore *store, GtkTreeIter *iter,
-                  Dwarf_Die *die, const char *name)
-{
-  gchar *offset = g_strdup_printf ("%" G_GINT64_MODIFIER "x",
-                                   dwarf_dieoffset (die));
-  gchar *tag = DW_TAG__strdup_hex (dwarf_tag (die));
-
-  GString *typename = NULL;
-  if (name == NULL)
-    {
-      Dwarf_Die cu;
-      Dwarf_Attribute attr;
-      Dwarf_Sword lang;
-      if (dwarf_diecu (die, &cu, NULL, NULL) &&
-          dwarf_attr (&cu, DW_AT_language, &attr) &&
-          dwarf_formsdata (&attr, &lang) == 0)
-        switch (lang) {
-            case DW_LANG_C:
-            case DW_LANG_C89:
-            case DW_LANG_C99:
-            case DW_LANG_C11:
-            case DW_LANG_C_plus_plus:
-            case DW_LANG_C_plus_plus_11:
-            case DW_LANG_C_plus_plus_14:
-              typename = dwarf_die_typename (die);
-              break;
-        }
-      name = (typename != NULL) ? typename->str : dwarf_diename (die);
-    }
-
-  gtk_tree_store_set (store, iter,
-                      DIE_TREE_COL_OFFSET, offset,
-                      DIE_TREE_COL_TAG, tag,
-                      DIE_TREE_COL_NAME, name,
-                      DIE_TREE_INT_DIE, die,
-                      -1);
-
-  g_free (offset);
-  g_free (tag);
-  if (typename != NULL)
-    g_string_free (typename, TRUE);
-
-  if (dwarf_haschildren (die))
-    {
-      GtkTreeIter placeholder;
-      gtk_tree_store_prepend (store, &placeholder, iter);
-    }
-}
-
-
-static GtkTreeIter *
-expand_die_children (GtkTreeStore *store, GtkTreeIter *iter,
-                     GtkTreeIter *parent, GtkTreeIter *sibling,
-                     Dwarf_Die *die, DwarvishSession *session)
-{
-  Dwarf_Die child;
-  if (dwarf_child (die, &child) == 0)
-    do
-      {
-        gboolean have_import = FALSE;
-        Dwarf_Die import;
-        if (!session->explicit_imports &&
-            dwarf_tag (&child) == DW_TAG_imported_unit)
-          {
-            Dwarf_Attribute attr;
-            have_import = (dwarf_attr (&child, DW_AT_import, &attr) != NULL
-                           && dwarf_formref_die (&attr, &import) != NULL);
-            if (!session->nested_imports && have_import)
-              {
-                sibling = expand_die_children (store, iter, parent, sibling,
-                                               &import, session);
-                continue;
-              }
-          }
-
-        if (sibling != NULL)
-          gtk_tree_store_insert_after (store, iter, parent, sibling);
-        die_tree_set_die (store, iter, &child, NULL);
-        sibling = iter;
-
-        if (session->nested_imports && have_import)
-          {
-            GtkTreeIter import_iter;
-            gtk_tree_store_insert_after (store, &import_iter, iter, NULL);
-            die_tree_set_die (store, &import_iter, &import, NULL);
-          }
-      }
-    while (dwarf_siblingof (&child, &child) == 0);
-  return sibling;
+  return die_tree_model_get_die (DIE_TREE_MODEL (model), iter, die_mem);
 }
 
 
+/* Fill in the real children, returning TRUE if there are none.  */
 static gboolean
 die_tree_iter_is_leaf (GtkTreeModel *model, GtkTreeIter *iter)
 {
-  GtkTreeIter first_child;
-  if (!gtk_tree_model_iter_children (model, &first_child, iter))
-    return TRUE;
-
-  Dwarf_Die die;
-  if (die_tree_get_die (model, &first_child, &die))
-    return FALSE; /* It's not just a placeholder, we're done.  */
-
-  if (!die_tree_get_die (model, iter, &die))
-    g_return_val_if_reached(TRUE);
-
-  /* Fill in the real children.  */
-  DwarvishSession *session = g_object_get_data (G_OBJECT (model),
-                                                "DwarvishSession");
-  GtkTreeStore *store = GTK_TREE_STORE (model);
-  GtkTreeIter child = first_child;
-  GtkTreeIter *last = expand_die_children (store, &child, iter, NULL,
-                                           &die, session);
-
-  if (last != NULL)
-    return FALSE;
-
-  /* Nothing was inserted, so remove the placeholder.
-   * NB: This leaves no children -- must have been empty imports?!  */
-  gtk_tree_store_remove (store, &first_child);
-  return TRUE;
+  return !die_tree_model_expand (DIE_TREE_MODEL (model), iter);
 }
 
 
@@ -328,48 +54,45 @@ signal_die_tree_test_expand_row (GtkTreeView *tree_view, GtkTreeIter *iter,
 }
 
 
-/* Search depth-first for a matching die, and return its path.  */
-static GtkTreePath *
-die_tree_search_down (GtkTreeModel *model, Dwarf_Die *search_die,
-                      GtkTreeIter *iter)
+/* Find a DIE among the units listed so far, and relocate the cursor
+ * there.  Returns FALSE if it wasn't found.  */
+static gboolean
+die_tree_view_goto_listed_die (GtkTreeView *view, Dwarf_Die *die)
 {
-  Dwarf_Die die;
-  if (die_tree_get_die (model, iter, &die) &&
-      die.addr == search_die->addr)
-    return gtk_tree_model_get_path (model, iter);
-
-  GtkTreeIter child;
-  if (die_tree_iter_is_leaf (model, iter) ||
-      !gtk_tree_model_iter_children (model, &child, iter))
-    return NULL;
+  GtkTreeModel *model = gtk_tree_view_get_model (view);
 
-  GtkTreePath *path;
-  do
-    path = die_tree_search_down (model, search_die, &child);
-  while (path == NULL && gtk_tree_model_iter_next (model, &child));
-  return path;
+  /* Look up the path of the DIE through the parent index, expanding only
+   * its ancestors.  The current cursor is a hint for which importer to go
+   * through, if the DIE is in a partial unit.  */
+  GtkTreeIter iter;
+  GtkTreePath *cursor_path;
+  gtk_tree_view_get_cursor (view, &cursor_path, NULL);
+  gboolean have_cursor = (cursor_path != NULL
+                          && gtk_tree_model_get_iter (model, &iter,
+                                                      cursor_path));
+  GtkTreePath *diepath = die_tree_model_find_die (DIE_TREE_MODEL (model), die,
+                                                  have_cursor ? &iter : NULL);
+  if (diepath != NULL)
+    {
+      /* Expand nodes up to but not including the target.  */
+      GtkTreePath *parentpath = gtk_tree_path_copy (diepath);
+      if (gtk_tree_path_up (parentpath)
+          && gtk_tree_path_get_depth (parentpath) > 0)
+        gtk_tree_view_expand_to_path (view, parentpath);
+      gtk_tree_path_free (parentpath);
+
+      /* Select the target.  */
+      gtk_tree_view_set_cursor (view, diepath, NULL, FALSE);
+      gtk_tree_path_free (diepath);
+    }
+  if (cursor_path != NULL)
+    gtk_tree_path_free (cursor_path);
+  return diepath != NULL;
 }
 
 
-/* Search depth-first for a matching die, retrying upwards if needed.  */
-static GtkTreePath *
-die_tree_search_up (GtkTreeModel *model, Dwarf_Die *search_die,
-                    GtkTreeIter *iter)
-{
-  /* First look downward.  */
-  GtkTreePath *path = die_tree_search_down (model, search_die, iter);
-  if (path != NULL)
-    return path;
-
-  /* No luck, then try again from this parent.
-   * NB: As written, this will not cross into other CUs.  */
-  GtkTreeIter parent;
-  if (gtk_tree_model_iter_parent (model, &parent, iter))
-    return die_tree_search_up (model, search_die, &parent);
-
-  return NULL;
-}
-
+static void die_tree_view_goto_signature (GtkTreeView *view,
+                                          Dwarf_Attribute *attr);
 
 /* When a "ref" attribute is activated (enter / double-click), find the
  * corresponding DIE in its tree and relocate the cursor there.  */
@@ -379,42 +102,19 @@ signal_attr_tree_row_activated (GtkTreeView *attrview,
                                 G_GNUC_UNUSED GtkTreeViewColumn *column,
                                 gpointer user_data)
 {
-  GtkTreeView *view = GTK_TREE_VIEW (user_data);
-  GtkTreeModel *model = gtk_tree_view_get_model (view);
-
   /* First read the DIE from the attribute.  */
   Dwarf_Attribute attr;
   Dwarf_Die die;
   GtkTreeIter iter;
   GtkTreeModel *attrmodel = gtk_tree_view_get_model (attrview);
   if (!gtk_tree_model_get_iter (attrmodel, &iter, path)
-      || !attr_tree_get_attribute (attrmodel, &iter, &attr)
-      || !dwarf_formref_die (&attr, &die))
+      || !attr_tree_get_attribute (attrmodel, &iter, &attr))
     return;
 
-  /* Now search for the same die->addr in the die tree.  It's a depth-first
-   * search which starts on the current die cursor.  If that fails it tries
-   * again from the parent, etc.  That way we can hopefully keep the lazy
-   * expansion to a minimum.  */
-  GtkTreePath *cursor_path;
-  gtk_tree_view_get_cursor (view, &cursor_path, NULL);
-  if (gtk_tree_model_get_iter (model, &iter, cursor_path))
-    {
-      GtkTreePath *diepath = die_tree_search_up (model, &die, &iter);
-      if (diepath != NULL)
-        {
-          /* Expand nodes up to but not including the target.  */
-          GtkTreePath *parentpath = gtk_tree_path_copy (diepath);
-          gtk_tree_path_up (parentpath);
-          gtk_tree_view_expand_to_path (view, parentpath);
-          gtk_tree_path_free (parentpath);
-
-          /* Select the target.  */
-          gtk_tree_view_set_cursor (view, diepath, NULL, FALSE);
-          gtk_tree_path_free (diepath);
-        }
-    }
-  gtk_tree_path_free (cursor_path);
+  if (dwarf_whatform (&attr) == DW_FORM_ref_sig8)
+    die_tree_view_goto_signature (GTK_TREE_VIEW (user_data), &attr);
+  else if (dwarf_formref_die (&attr, &die))
+    die_tree_view_goto_die (GTK_TREE_VIEW (user_data), &die);
 }
 
 
@@ -448,6 +148,33 @@ signal_die_tree_query_tooltip (GtkWidget *widget,
 }
 
 
+/* The offset and tag are formatted only for the rows being drawn, and
+ * loading placeholders leave them blank.  */
+static void
+die_tree_cell_data (G_GNUC_UNUSED GtkTreeViewColumn *col,
+                    GtkCellRenderer *renderer, GtkTreeModel *model,
+                    GtkTreeIter *iter, gpointer data)
+{
+  Dwarf_Die die;
+  if (!die_tree_get_die (model, iter, &die))
+    {
+      g_object_set (renderer, "text", NULL, NULL);
+      return;
+    }
+
+  if (GPOINTER_TO_INT (data) == DIE_TREE_COL_TAG)
+    {
+      g_object_set (renderer, "text", DW_TAG__name (dwarf_tag (&die)), NULL);
+      return;
+    }
+
+  char offset[24];
+  g_snprintf (offset, sizeof offset, "%" G_GINT64_MODIFIER "x",
+              dwarf_dieoffset (&die));
+  g_object_set (renderer, "text", offset, NULL);
+}
+
+
 static void
 die_tree_render_column (GtkTreeView *view, gint column)
 {
@@ -458,64 +185,465 @@ die_tree_render_column (GtkTreeView *view, gint column)
     g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
 
   gtk_tree_view_column_pack_start (col, renderer, TRUE);
-  gtk_tree_view_column_add_attribute (col, renderer, "text", column);
+  if (column == DIE_TREE_COL_NAME)
+    gtk_tree_view_column_add_attribute (col, renderer, "text", column);
+  else
+    gtk_tree_view_column_set_cell_data_func (col, renderer,
+                                             die_tree_cell_data,
+                                             GINT_TO_POINTER (column), NULL);
 }
 
 
-gboolean
-die_tree_view_render (GtkTreeView *view, DwarvishSession *session,
-                      gboolean types)
+/* Rows that finished loading in the background were collapsed when their
+ * placeholder went away, so expand them again with all their children.  */
+static void
+signal_die_tree_children_loaded (G_GNUC_UNUSED DieTreeModel *model,
+                                 GtkTreePath *path, gpointer user_data)
 {
-  GtkTreeStore *store = gtk_tree_store_new (DIE_TREE_N_COLUMNS,
-                                            G_TYPE_STRING,
-                                            G_TYPE_STRING,
-                                            G_TYPE_STRING,
-                                            G_TYPE_DWARF_DIE);
-  g_object_set_data (G_OBJECT (store), "DwarvishSession", session);
+  gtk_tree_view_expand_row (GTK_TREE_VIEW (user_data), path, FALSE);
+}
 
-  uint64_t type_signature;
-  uint64_t *ptype_signature = types ? &type_signature : NULL;
-  typeof (dwarf_offdie) *offdie = types ? dwarf_offdie_types : dwarf_offdie;
 
-  gboolean empty = TRUE;
+/* Units are scanned on a worker thread, which only reads the unit headers,
+ * and the main loop turns those into rows in batches, within the same
+ * budget as the model's fills.  The first batch is read right away with
+ * the session's own handle, so the first screen doesn't wait for the
+ * thread to begin its clone.  If the index cache has the unit table,
+ * that's used instead of scanning.  If a clone can't be begun, the main
+ * loop scans the rest itself, a small batch at a time.  */
+#define DIE_TREE_FIRST_BATCH 64
+#define DIE_TREE_BATCH 256
+#define DIE_TREE_POLL_MS 10
+#define DIE_TREE_POLL_BUDGET_US 8000
+
+typedef IndexCacheUnit DieTreeUnit;
+
+typedef struct _DieTreeLoader
+{
+  DieTreeModel *model;  /* Not a reference; this is owned by the model.  */
+  DwarvishSession *session;
+  gboolean types;
+  GtkSpinner *spinner;
+  guint n_units;
+
+  const DieTreeUnit *cached;    /* The cache's unit table, if any.  */
+  gsize n_cached;
+  gsize next_cached;
+  Dwarf_Off next_offset;        /* Of the next unit header to scan.  */
+
+  GThread *thread;
+  GAsyncQueue *queue;   /* Batches of DieTreeUnit, then an empty batch.  */
+  gint cancelled;
+  gint unscanned;       /* The thread couldn't begin a clone to scan.  */
+  gboolean scan_here;   /* So the poll scans instead.  */
+  guint source_id;
+} DieTreeLoader;
+
+
+/* Read up to max more units into the batch, which is left empty once
+ * there are no more.  Only one thread reads at a time.  */
+static void
+die_tree_loader_read (DieTreeLoader *loader, Dwarf *dwarf, GArray *batch,
+                      guint max)
+{
+  if (loader->cached != NULL)
+    {
+      gsize n = MIN (loader->n_cached - loader->next_cached, max);
+      g_array_append_vals (batch, loader->cached + loader->next_cached, n);
+      loader->next_cached += n;
+      return;
+    }
+
+  DieTreeUnit unit = { 0, 0, 0 };
+  uint64_t *ptype_signature = loader->types ? &unit.type_signature : NULL;
+  Dwarf_Off noff, type_offset = 0;
   size_t cuhl;
-  GtkTreeIter iter, *sibling = NULL;
-  for (Dwarf_Off noff, off = 0;
-       dwarf_next_unit (session->dwarf, off, &noff, &cuhl, NULL,
-                        NULL, NULL, NULL, ptype_signature, NULL) == 0;
-       off = noff)
+  while (batch->len < max
+         && dwarf_next_unit (dwarf, loader->next_offset, &noff, &cuhl, NULL,
+                             NULL, NULL, NULL, ptype_signature,
+                             loader->types ? &type_offset : NULL) == 0)
+    {
+      unit.offset = loader->next_offset + cuhl;
+      unit.type_offset = loader->types ? loader->next_offset + type_offset : 0;
+      g_array_append_val (batch, unit);
+      loader->next_offset = noff;
+    }
+}
+
+
+/* Libdw handles aren't safe to share with the main thread, so the thread
+ * scans with its own clone of the session.  The cached unit table needs
+ * no handle at all.  */
+static gpointer
+die_tree_loader_thread (gpointer data)
+{
+  DieTreeLoader *loader = data;
+  gint64 start = profile_begin ();
+
+  DwarvishSession *clone = NULL;
+  if (loader->cached == NULL)
+    {
+      const char *error;
+      clone = session_clone (loader->session, &error);
+      if (clone == NULL)
+        g_atomic_int_set (&loader->unscanned, TRUE);
+    }
+
+  while ((clone != NULL || loader->cached != NULL)
+         && !g_atomic_int_get (&loader->cancelled))
     {
+      GArray *batch = g_array_sized_new (FALSE, FALSE, sizeof (DieTreeUnit),
+                                         DIE_TREE_BATCH);
+      die_tree_loader_read (loader, clone ? clone->dwarf : NULL, batch,
+                            DIE_TREE_BATCH);
+      if (batch->len == 0)
+        {
+          g_array_free (batch, TRUE);
+          break;
+        }
+      g_async_queue_push (loader->queue, batch);
+    }
+
+  g_async_queue_push (loader->queue,
+                      g_array_new (FALSE, FALSE, sizeof (DieTreeUnit)));
+  if (clone != NULL)
+    session_end (clone);
+  profile_end (start, loader->types ? "scan type units" : "scan units");
+  return NULL;
+}
+
+
+static void
+die_tree_loader_add_batch (DieTreeLoader *loader, GArray *batch)
+{
+  DwarvishSession *session = loader->session;
+  typeof (dwarf_offdie) *offdie = loader->types ? dwarf_offdie_types
+    : dwarf_offdie;
+  gint64 start = profile_begin ();
+
+  for (guint i = 0; i < batch->len; ++i)
+    {
+      DieTreeUnit *unit = &g_array_index (batch, DieTreeUnit, i);
       Dwarf_Die die;
-      if (offdie (session->dwarf, off + cuhl, &die) == NULL)
+      if (offdie (session->dwarf, unit->offset, &die) == NULL)
         continue;
 
       if (!session->explicit_imports &&
           dwarf_tag (&die) == DW_TAG_partial_unit)
         continue;
 
-      char *sig8_name = NULL;
-      const char *name = dwarf_diename (&die);
-      if (name == NULL && types)
-        name = sig8_name = g_strdup_printf ("{%016" G_GINT64_MODIFIER "x}",
-                                            type_signature);
+      die_tree_model_append_unit (loader->model, &die, unit->type_signature);
+      if (loader->types)
+        sig_index_add (session, unit->type_signature, unit->type_offset,
+                       TRUE);
+      else
+        sig_index_add_unit (session, &die);
+    }
+  profile_end (start, "add units");
+
+  loader->n_units += batch->len;
+  if (loader->spinner != NULL)
+    {
+      gchar *text = g_strdup_printf ("Loading units: %u", loader->n_units);
+      gtk_widget_set_tooltip_text (GTK_WIDGET (loader->spinner), text);
+      g_free (text);
+    }
+}
+
+
+static void
+die_tree_loader_finish (DieTreeLoader *loader)
+{
+  sig_index_set_complete (loader->session, loader->types);
+  if (loader->spinner != NULL)
+    {
+      gtk_spinner_stop (loader->spinner);
+      gtk_widget_hide (GTK_WIDGET (loader->spinner));
+    }
+  loader->source_id = 0;
+}
+
+
+/* Get the next batch from the thread, or scan one here once the thread
+ * has given up.  */
+static GArray *
+die_tree_loader_next_batch (DieTreeLoader *loader)
+{
+  if (!loader->scan_here)
+    {
+      GArray *batch = g_async_queue_try_pop (loader->queue);
+      if (batch == NULL || batch->len > 0
+          || !g_atomic_int_get (&loader->unscanned))
+        return batch;
+
+      g_array_free (batch, TRUE);
+      loader->scan_here = TRUE;
+    }
+
+  GArray *batch = g_array_sized_new (FALSE, FALSE, sizeof (DieTreeUnit),
+                                     DIE_TREE_FIRST_BATCH);
+  die_tree_loader_read (loader, loader->session->dwarf, batch,
+                        DIE_TREE_FIRST_BATCH);
+  return batch;
+}
+
+
+static gboolean
+die_tree_loader_poll (gpointer data)
+{
+  DieTreeLoader *loader = data;
+  gint64 deadline = g_get_monotonic_time () + DIE_TREE_POLL_BUDGET_US;
+
+  GArray *batch;
+  while (g_get_monotonic_time () < deadline
+         && (batch = die_tree_loader_next_batch (loader)) != NULL)
+    {
+      gboolean done = (batch->len == 0);
+      if (!done)
+        die_tree_loader_add_batch (loader, batch);
+      g_array_free (batch, TRUE);
+
+      if (done)
+        {
+          die_tree_loader_finish (loader);
+          return G_SOURCE_REMOVE;
+        }
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+static void
+die_tree_loader_free (gpointer data)
+{
+  DieTreeLoader *loader = data;
+
+  g_atomic_int_set (&loader->cancelled, TRUE);
+  if (loader->thread != NULL)
+    g_thread_join (loader->thread);
+  if (loader->source_id != 0)
+    g_source_remove (loader->source_id);
+
+  GArray *batch;
+  while ((batch = g_async_queue_try_pop (loader->queue)) != NULL)
+    g_array_free (batch, TRUE);
+  g_async_queue_unref (loader->queue);
+
+  if (loader->spinner != NULL)
+    g_object_unref (loader->spinner);
+  g_slice_free (DieTreeLoader, loader);
+}
+
 
-      empty = FALSE;
-      gtk_tree_store_insert_after (store, &iter, NULL, sibling);
-      die_tree_set_die (store, &iter, &die, name);
-      sibling = &iter;
+static void
+die_tree_loader_start (DieTreeModel *model, DwarvishSession *session,
+                       gboolean types, GtkSpinner *spinner)
+{
+  DieTreeLoader *loader = g_slice_new0 (DieTreeLoader);
+  loader->model = model;
+  loader->session = session;
+  loader->types = types;
+  loader->queue = g_async_queue_new ();
+  loader->cached = index_cache_section (session->index_caches[types],
+                                        INDEX_CACHE_UNITS,
+                                        &loader->n_cached);
+
+  /* The model owns the loader, so the thread is stopped with it.  */
+  g_object_set_data_full (G_OBJECT (model), "DieTreeLoader",
+                          loader, die_tree_loader_free);
+
+  GArray *batch = g_array_sized_new (FALSE, FALSE, sizeof (DieTreeUnit),
+                                     DIE_TREE_FIRST_BATCH);
+  die_tree_loader_read (loader, session->dwarf, batch, DIE_TREE_FIRST_BATCH);
+  die_tree_loader_add_batch (loader, batch);
+  gboolean more = (batch->len == DIE_TREE_FIRST_BATCH);
+  g_array_free (batch, TRUE);
+  if (!more)
+    {
+      die_tree_loader_finish (loader);
+      return;
+    }
 
-      if (sig8_name)
-        g_free (sig8_name);
+  if (spinner != NULL)
+    {
+      loader->spinner = g_object_ref (spinner);
+      gtk_widget_show (GTK_WIDGET (spinner));
+      gtk_spinner_start (spinner);
     }
 
-  gtk_tree_view_set_model (view, GTK_TREE_MODEL (store));
-  g_object_unref (store); /* The view keeps its own reference.  */
+  loader->thread = g_thread_new ("dwarvish-units",
+                                 die_tree_loader_thread, loader);
+  loader->source_id = g_timeout_add (DIE_TREE_POLL_MS,
+                                     die_tree_loader_poll, loader);
+}
+
+
+/* Start listing the units in a new model, as a view shows them.  */
+DieTreeModel *
+die_tree_load_units (DwarvishSession *session, gboolean types,
+                     GtkSpinner *spinner)
+{
+  DieTreeModel *model = die_tree_model_new (session, types);
+  die_tree_loader_start (model, session, types, spinner);
+  return model;
+}
+
+
+/* Whether a model's units are still being listed by the main loop.  */
+gboolean
+die_tree_units_loading (GtkTreeModel *model)
+{
+  DieTreeLoader *loader = g_object_get_data (G_OBJECT (model),
+                                             "DieTreeLoader");
+  return loader != NULL && loader->source_id != 0;
+}
+
+
+/* A jump waits for the view's units to finish loading, and is dropped
+ * with the view.  */
+typedef struct _DieTreeGoto
+{
+  GtkTreeView *view;
+  Dwarf_Die die;
+  guint source_id;
+} DieTreeGoto;
+
+
+static void
+die_tree_goto_free (gpointer data)
+{
+  DieTreeGoto *pending = data;
+  if (pending->source_id != 0)
+    g_source_remove (pending->source_id);
+  g_slice_free (DieTreeGoto, pending);
+}
+
+
+static gboolean
+die_tree_goto_poll (gpointer data)
+{
+  DieTreeGoto *pending = data;
+  if (die_tree_units_loading (gtk_tree_view_get_model (pending->view)))
+    return G_SOURCE_CONTINUE;
+
+  pending->source_id = 0;
+  die_tree_view_goto_listed_die (pending->view, &pending->die);
+  g_object_set_data (G_OBJECT (pending->view), "DieTreeGoto", NULL);
+  return G_SOURCE_REMOVE;
+}
+
+
+/* Find a DIE in the tree and relocate the cursor there.  If its unit
+ * hasn't been listed yet, the jump waits for the rest of the units.  */
+void
+die_tree_view_goto_die (GtkTreeView *view, Dwarf_Die *die)
+{
+  /* A newer jump replaces any which is still waiting.  */
+  g_object_set_data (G_OBJECT (view), "DieTreeGoto", NULL);
+  if (die_tree_view_goto_listed_die (view, die))
+    return;
+
+  if (!die_tree_units_loading (gtk_tree_view_get_model (view)))
+    return;
+
+  DieTreeGoto *pending = g_slice_new (DieTreeGoto);
+  pending->view = view;
+  pending->die = *die;
+  pending->source_id = g_timeout_add (DIE_TREE_POLL_MS, die_tree_goto_poll,
+                                      pending);
+  g_object_set_data_full (G_OBJECT (view), "DieTreeGoto",
+                          pending, die_tree_goto_free);
+}
+
+
+/* Views can open the other view of their session, to follow signature
+ * references between .debug_info and .debug_types.  */
+typedef struct _DieTreeOpen
+{
+  DieTreeOpenFunc open;
+  gpointer user_data;
+} DieTreeOpen;
+
+
+static void
+die_tree_open_free (gpointer data)
+{
+  g_slice_free (DieTreeOpen, data);
+}
+
+
+void
+die_tree_view_set_open_func (GtkTreeView *view, DieTreeOpenFunc open,
+                             gpointer user_data)
+{
+  DieTreeOpen *tree_open = g_slice_new (DieTreeOpen);
+  tree_open->open = open;
+  tree_open->user_data = user_data;
+  g_object_set_data_full (G_OBJECT (view), "DieTreeOpen",
+                          tree_open, die_tree_open_free);
+}
+
+
+/* Type signatures are looked up in the session's index rather than
+ * searched for, and their DIEs are shown in the view of their section.  */
+static void
+die_tree_view_goto_signature (GtkTreeView *view, Dwarf_Attribute *attr)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model (view);
+  DwarvishSession *session = g_object_get_data (G_OBJECT (model),
+                                                "DwarvishSession");
+  Dwarf_Die die;
+  gboolean types;
+  if (!sig_index_lookup (session, attr, &die, &types))
+    return;
+
+  if (die_tree_model_get_types (DIE_TREE_MODEL (model)) != types)
+    {
+      DieTreeOpen *tree_open = g_object_get_data (G_OBJECT (view),
+                                                  "DieTreeOpen");
+      view = tree_open ? tree_open->open (session, types,
+                                          tree_open->user_data) : NULL;
+      if (view == NULL)
+        return;
+    }
+
+  die_tree_view_goto_die (view, &die);
+}
+
+
+/* Only check that there's a first unit, so empty views are skipped.  The
+ * rest are found in the background once a view is rendered.  */
+gboolean
+die_tree_has_units (DwarvishSession *session, gboolean types)
+{
+  size_t cuhl;
+  Dwarf_Off noff;
+  uint64_t type_signature;
+  return dwarf_next_unit (session->dwarf, 0, &noff, &cuhl, NULL, NULL, NULL,
+                          NULL, types ? &type_signature : NULL, NULL) == 0;
+}
+
+
+gboolean
+die_tree_view_render (GtkTreeView *view, DwarvishSession *session,
+                      gboolean types, GtkSpinner *spinner)
+{
+  if (!die_tree_has_units (session, types))
+    return FALSE;
+
+  DieTreeModel *model = die_tree_load_units (session, types, spinner);
+  g_signal_connect (model, "children-loaded",
+                    G_CALLBACK (signal_die_tree_children_loaded), view);
+
+  gtk_tree_view_set_model (view, GTK_TREE_MODEL (model));
+  g_object_unref (model); /* The view keeps its own reference.  */
 
   die_tree_render_column (view, DIE_TREE_COL_OFFSET);
   die_tree_render_column (view, DIE_TREE_COL_TAG);
   die_tree_render_column (view, DIE_TREE_COL_NAME);
 
-  return !empty;
+  return TRUE;
 }
 
 
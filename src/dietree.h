@@ -14,13 +14,42 @@
 #include <elfutils/libdw.h>
 #include <gtk/gtk.h>
 
+#include "dietreemodel.h"
 #include "session.h"
 
 
+G_GNUC_INTERNAL
+gboolean die_tree_has_units (DwarvishSession *session,
+                             gboolean types);
+
+G_GNUC_INTERNAL
+DieTreeModel *die_tree_load_units (DwarvishSession *session,
+                                   gboolean types,
+                                   GtkSpinner *spinner);
+
+G_GNUC_INTERNAL
+gboolean die_tree_units_loading (GtkTreeModel *model);
+
 G_GNUC_INTERNAL
 gboolean die_tree_view_render (GtkTreeView *view,
                                DwarvishSession *session,
-                               gboolean types);
+                               gboolean types,
+                               GtkSpinner *spinner);
+
+/* Called to show a session's .debug_info or .debug_types view, returning
+ * its die tree.  */
+typedef GtkTreeView *(*DieTreeOpenFunc) (DwarvishSession *session,
+                                         gboolean types,
+                                         gpointer user_data);
+
+G_GNUC_INTERNAL
+void die_tree_view_set_open_func (GtkTreeView *view,
+                                  DieTreeOpenFunc open,
+                                  gpointer user_data);
+
+G_GNUC_INTERNAL
+void die_tree_view_goto_die (GtkTreeView *view,
+                             Dwarf_Die *die);
 
 G_GNUC_INTERNAL
 gboolean die_tree_get_die (GtkTreeModel *model,
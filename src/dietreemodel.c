@@ -0,0 +1,1183 @@
+/*
+ * die-tree model implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <dwarf.h>
+#include "dietreemodel.h"
+#include "cuinfo.h"
+#include "dieindex.h"
+#include "dietree.h"
+#include "profile.h"
+#include "splitunit.h"
+#include "typename.h"
+
+
+/* Rows are stored only as DIE offsets.  The top bits of each offset select
+ * which Dwarf (and section) it belongs to, since flattened imports may pull
+ * in DIEs from the dwz alt file, and the Types view reads .debug_types.
+ * The last slot is for split units, whose files may be closed and opened
+ * again, so those keep the split unit's index and the offset within its
+ * file instead.  */
+#define DIE_SLOT_SHIFT 62
+#define DIE_SLOT_MASK ((Dwarf_Off) 3 << DIE_SLOT_SHIFT)
+#define DIE_N_SLOTS 4
+#define DIE_SLOT_SPLIT (DIE_N_SLOTS - 1)
+#define DIE_SPLIT_SHIFT 32
+#define DIE_SPLIT_MASK (((Dwarf_Off) 1 << DIE_SPLIT_SHIFT) - 1)
+
+typedef struct _DieTreeSlot
+{
+  Dwarf *dwarf;
+  gboolean types;
+} DieTreeSlot;
+
+
+/* Children are gathered in time-limited steps, so huge nodes don't stall
+ * the main loop.  Most nodes are done within the first step, and the rest
+ * show a placeholder row until they finish in the background.  Then the
+ * placeholder is replaced by the real rows, which are announced to the
+ * view in steps within the same budget.  */
+#define DIE_TREE_FILL_BUDGET_US 8000
+#define DIE_TREE_PLACEHOLDER G_MAXUINT64
+
+typedef struct _DieTreeNode DieTreeNode;
+
+typedef struct _DieTreeCursor
+{
+  Dwarf_Die die;        /* The next DIE to visit at this level.  */
+  gboolean types;
+} DieTreeCursor;
+
+typedef struct _DieTreeFill
+{
+  DieTreeModel *model;
+  DieTreeNode *node;
+  GArray *children;     /* Encoded Dwarf_Off gathered so far.  */
+  GArray *stack;        /* DieTreeCursor, one level per DIE being walked.  */
+  guint source_id;
+  gboolean gathered;    /* The placeholder is gone, and rows are moving.  */
+  guint next_insert;    /* The next of the children to announce.  */
+} DieTreeFill;
+
+
+/* A node exists only for rows whose children have been asked for.  Its own
+ * DIE is found in the parent's children array at its index.  */
+struct _DieTreeNode
+{
+  DieTreeNode *parent;
+  guint index;
+  GArray *children;     /* Encoded Dwarf_Off, or NULL until filled.  */
+  GHashTable *nodes;    /* Child index -> DieTreeNode, as they're used.  */
+  DieTreeFill *fill;    /* Set while children are loading.  */
+  GArray *order;        /* Child indexes by offset, once looked up.  */
+};
+
+
+struct _DieTreeModel
+{
+  GObject parent;
+
+  gint stamp;
+  DwarvishSession *session;
+  gboolean types;
+
+  DieTreeSlot slots[DIE_N_SLOTS];
+  guint n_slots;
+
+  DieTreeNode root;
+  GArray *signatures;   /* Type signatures of the root rows, if types.  */
+  GHashTable *imports;  /* Partial unit CU -> flattened encoded children.  */
+};
+
+struct _DieTreeModelClass
+{
+  GObjectClass parent_class;
+};
+
+
+static void die_tree_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (DieTreeModel, die_tree_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                die_tree_model_tree_model_init))
+
+enum
+{
+  CHILDREN_LOADED,
+  LAST_SIGNAL
+};
+
+static guint die_tree_model_signals[LAST_SIGNAL];
+
+
+static void
+die_tree_fill_free (DieTreeFill *fill)
+{
+  if (fill->source_id != 0)
+    g_source_remove (fill->source_id);
+  if (fill->children != NULL)
+    g_array_free (fill->children, TRUE);
+  g_array_free (fill->stack, TRUE);
+  g_slice_free (DieTreeFill, fill);
+}
+
+
+static void
+die_tree_node_free (gpointer data)
+{
+  DieTreeNode *node = data;
+  if (node->fill != NULL)
+    die_tree_fill_free (node->fill);
+  if (node->children != NULL)
+    g_array_free (node->children, TRUE);
+  if (node->nodes != NULL)
+    g_hash_table_destroy (node->nodes);
+  if (node->order != NULL)
+    g_array_free (node->order, TRUE);
+  g_slice_free (DieTreeNode, node);
+}
+
+
+static Dwarf_Off
+die_tree_model_encode (DieTreeModel *model, Dwarf_Die *die, gboolean types)
+{
+  guint split;
+  if (split_unit_index (model->session, die, &split))
+    {
+      Dwarf_Off offset = dwarf_dieoffset (die);
+      g_return_val_if_fail ((split >> (DIE_SLOT_SHIFT - DIE_SPLIT_SHIFT)) == 0
+                            && offset <= DIE_SPLIT_MASK, 0);
+      return (offset | ((Dwarf_Off) split << DIE_SPLIT_SHIFT)
+              | ((Dwarf_Off) DIE_SLOT_SPLIT << DIE_SLOT_SHIFT));
+    }
+
+  Dwarf *dwarf = dwarf_cu_getdwarf (die->cu);
+  guint slot;
+  for (slot = 0; slot < model->n_slots; ++slot)
+    if (model->slots[slot].dwarf == dwarf
+        && model->slots[slot].types == types)
+      break;
+
+  if (slot == model->n_slots)
+    {
+      g_return_val_if_fail (slot < DIE_SLOT_SPLIT, 0);
+      model->slots[slot].dwarf = dwarf;
+      model->slots[slot].types = types;
+      ++model->n_slots;
+    }
+
+  return dwarf_dieoffset (die) | ((Dwarf_Off) slot << DIE_SLOT_SHIFT);
+}
+
+
+static gboolean
+die_tree_model_decode (DieTreeModel *model, Dwarf_Off encoded,
+                       Dwarf_Die *die, gboolean *types)
+{
+  Dwarf_Off offset = encoded & ~DIE_SLOT_MASK;
+  if (encoded >> DIE_SLOT_SHIFT == DIE_SLOT_SPLIT)
+    {
+      if (types != NULL)
+        *types = FALSE;
+      return split_unit_offdie (model->session, offset >> DIE_SPLIT_SHIFT,
+                                offset & DIE_SPLIT_MASK, die);
+    }
+
+  DieTreeSlot *slot = &model->slots[encoded >> DIE_SLOT_SHIFT];
+  if (types != NULL)
+    *types = slot->types;
+
+  if (slot->types)
+    return dwarf_offdie_types (slot->dwarf, offset, die) != NULL;
+  return dwarf_offdie (slot->dwarf, offset, die) != NULL;
+}
+
+
+static inline Dwarf_Off
+die_tree_node_child (DieTreeNode *node, guint index)
+{
+  return g_array_index (node->children, Dwarf_Off, index);
+}
+
+
+/* Find the node for a child row, creating it if requested.  */
+static DieTreeNode *
+die_tree_node_get_child (DieTreeNode *node, guint index, gboolean create)
+{
+  DieTreeNode *child = NULL;
+  if (node->nodes != NULL)
+    child = g_hash_table_lookup (node->nodes, GUINT_TO_POINTER (index));
+  else if (create)
+    node->nodes = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                         NULL, die_tree_node_free);
+
+  if (child == NULL && create)
+    {
+      child = g_slice_new0 (DieTreeNode);
+      child->parent = node;
+      child->index = index;
+      g_hash_table_insert (node->nodes, GUINT_TO_POINTER (index), child);
+    }
+
+  return child;
+}
+
+
+/* Get the import target of a DW_TAG_imported_unit.  */
+static gboolean
+dwarf_die_import (Dwarf_Die *die, Dwarf_Die *import)
+{
+  Dwarf_Attribute attr;
+  return (dwarf_tag (die) == DW_TAG_imported_unit
+          && dwarf_attr (die, DW_AT_import, &attr) != NULL
+          && dwarf_formref_die (&attr, import) != NULL);
+}
+
+
+static inline gboolean
+die_tree_model_set_iter (DieTreeModel *model, GtkTreeIter *iter,
+                         DieTreeNode *node, guint index)
+{
+  if (node->children == NULL || index >= node->children->len)
+    return FALSE;
+
+  iter->stamp = model->stamp;
+  iter->user_data = node;
+  iter->user_data2 = GUINT_TO_POINTER (index);
+  iter->user_data3 = NULL;
+  return TRUE;
+}
+
+
+static inline DieTreeNode *
+die_tree_model_iter_node (DieTreeModel *model, GtkTreeIter *iter)
+{
+  g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+  return iter->user_data;
+}
+
+
+static inline guint
+die_tree_model_iter_index (GtkTreeIter *iter)
+{
+  return GPOINTER_TO_UINT (iter->user_data2);
+}
+
+
+static void
+die_tree_fill_push (DieTreeFill *fill, Dwarf_Die *die, gboolean types)
+{
+  DieTreeCursor cursor;
+  if (dwarf_child (die, &cursor.die) == 0)
+    {
+      cursor.types = types;
+      g_array_append_val (fill->stack, cursor);
+    }
+}
+
+
+static DieTreeFill *
+die_tree_fill_new (DieTreeModel *model, DieTreeNode *node)
+{
+  DieTreeFill *fill = g_slice_new0 (DieTreeFill);
+  fill->model = model;
+  fill->node = node;
+  fill->children = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+  fill->stack = g_array_new (FALSE, FALSE, sizeof (DieTreeCursor));
+  g_return_val_if_fail (node->parent != NULL, fill);
+
+  Dwarf_Die die, import, split;
+  gboolean types;
+  /* The placeholder row has no DIE, so nothing below it.  */
+  Dwarf_Off offset = die_tree_node_child (node->parent, node->index);
+  if (offset == DIE_TREE_PLACEHOLDER
+      || !die_tree_model_decode (model, offset, &die, &types))
+    return fill;
+
+  /* A skeleton unit shows the children of its split unit, whose file is
+   * only opened now.  */
+  if (split_unit_get (model->session, &die, &split))
+    die = split;
+
+  /* Nested imports show the partial unit as the only child.  */
+  if (model->session->nested_imports && dwarf_die_import (&die, &import))
+    {
+      offset = die_tree_model_encode (model, &import, FALSE);
+      g_array_append_val (fill->children, offset);
+    }
+  else
+    die_tree_fill_push (fill, &die, types);
+
+  return fill;
+}
+
+
+/* The flattened children of a partial unit, including its own imports.  This
+ * is computed once per model, as dwz may import a unit from many places.  */
+static GArray *
+die_tree_model_import_children (DieTreeModel *model, Dwarf_Die *unit)
+{
+  GArray *children = g_hash_table_lookup (model->imports, unit->cu);
+  if (children != NULL)
+    return children;
+
+  /* Inserted up front, so an import cycle just sees a partial list.  */
+  children = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+  g_hash_table_insert (model->imports, unit->cu, children);
+
+  Dwarf_Die child;
+  if (dwarf_child (unit, &child) == 0)
+    do
+      {
+        Dwarf_Die import;
+        if (dwarf_die_import (&child, &import))
+          {
+            GArray *imported = die_tree_model_import_children (model,
+                                                                &import);
+            if (imported != children)
+              g_array_append_vals (children, imported->data, imported->len);
+            continue;
+          }
+
+        /* Partial units are always in .debug_info.  */
+        Dwarf_Off offset = die_tree_model_encode (model, &child, FALSE);
+        g_array_append_val (children, offset);
+      }
+    while (dwarf_siblingof (&child, &child) == 0);
+
+  return children;
+}
+
+
+/* Gather children until done, returning FALSE if the deadline passed
+ * first.  Imports are flattened unless requested otherwise.  */
+static gboolean
+die_tree_fill_step (DieTreeFill *fill, gint64 deadline)
+{
+  DieTreeModel *model = fill->model;
+  DwarvishSession *session = model->session;
+  gboolean flatten = !session->explicit_imports && !session->nested_imports;
+  gint64 start = profile_begin ();
+
+  guint count = 0;
+  while (fill->stack->len > 0)
+    {
+      DieTreeCursor *top = &g_array_index (fill->stack, DieTreeCursor,
+                                           fill->stack->len - 1);
+      Dwarf_Die child = top->die;
+      gboolean types = top->types;
+      if (dwarf_siblingof (&top->die, &top->die) != 0)
+        g_array_set_size (fill->stack, fill->stack->len - 1);
+
+      Dwarf_Die import;
+      if (flatten && dwarf_die_import (&child, &import))
+        {
+          GArray *imported = die_tree_model_import_children (model, &import);
+          g_array_append_vals (fill->children, imported->data, imported->len);
+        }
+      else
+        {
+          Dwarf_Off offset = die_tree_model_encode (model, &child, types);
+          g_array_append_val (fill->children, offset);
+        }
+
+      if (++count % 256 == 0 && g_get_monotonic_time () >= deadline)
+        break;
+    }
+
+  PROFILE_COUNT (PROFILE_DIES_VISITED, count);
+  profile_end (start, "fill rows");
+  return fill->stack->len == 0;
+}
+
+
+static GtkTreePath *
+die_tree_model_node_path (DieTreeNode *node)
+{
+  GtkTreePath *path = gtk_tree_path_new ();
+  for (; node->parent != NULL; node = node->parent)
+    gtk_tree_path_prepend_index (path, node->index);
+  return path;
+}
+
+
+/* Remove the placeholder of a fill which has gathered all the children,
+ * which leaves the row collapsed until they're all announced.  */
+static void
+die_tree_model_fill_swap (DieTreeModel *model, DieTreeNode *node)
+{
+  DieTreeFill *fill = node->fill;
+  fill->gathered = TRUE;
+
+  if (node->nodes != NULL)
+    g_hash_table_remove_all (node->nodes);
+  g_array_set_size (node->children, 0);
+
+  GtkTreePath *path = die_tree_model_node_path (node);
+  gtk_tree_path_append_index (path, 0);
+  gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+  gtk_tree_path_free (path);
+}
+
+
+/* Move the gathered children into the node, announcing each new row,
+ * returning FALSE if the deadline passed first.  */
+static gboolean
+die_tree_model_fill_insert (DieTreeModel *model, DieTreeNode *node,
+                            gint64 deadline)
+{
+  DieTreeFill *fill = node->fill;
+  GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
+  GtkTreePath *path = die_tree_model_node_path (node);
+  gtk_tree_path_append_index (path, 0);
+  gint64 start = profile_begin ();
+
+  guint count = 0;
+  while (fill->next_insert < fill->children->len)
+    {
+      guint index = fill->next_insert++;
+      g_array_append_val (node->children,
+                          g_array_index (fill->children, Dwarf_Off, index));
+
+      GtkTreeIter iter;
+      die_tree_model_set_iter (model, &iter, node, index);
+      gtk_tree_path_get_indices (path)[gtk_tree_path_get_depth (path) - 1]
+        = index;
+      gtk_tree_model_row_inserted (tree_model, path, &iter);
+      if (gtk_tree_model_iter_has_child (tree_model, &iter))
+        gtk_tree_model_row_has_child_toggled (tree_model, path, &iter);
+
+      if (++count % 64 == 0 && g_get_monotonic_time () >= deadline)
+        break;
+    }
+
+  PROFILE_COUNT (PROFILE_ROWS_INSERTED, count);
+  profile_end (start, "insert rows");
+  gtk_tree_path_free (path);
+
+  if (node->order != NULL)
+    {
+      g_array_free (node->order, TRUE);
+      node->order = NULL;
+    }
+  return fill->next_insert == fill->children->len;
+}
+
+
+/* Drop a fill whose children are all announced, and let the view know it
+ * may expand the row again.  */
+static void
+die_tree_model_fill_done (DieTreeModel *model, DieTreeNode *node)
+{
+  die_tree_fill_free (node->fill);
+  node->fill = NULL;
+
+  GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
+  GtkTreePath *path = die_tree_model_node_path (node);
+  if (node->children->len > 0)
+    g_signal_emit (model, die_tree_model_signals[CHILDREN_LOADED], 0, path);
+  else
+    {
+      GtkTreeIter iter;
+      die_tree_model_set_iter (model, &iter, node->parent, node->index);
+      gtk_tree_model_row_has_child_toggled (tree_model, path, &iter);
+    }
+  gtk_tree_path_free (path);
+}
+
+
+static gboolean
+die_tree_fill_idle (gpointer data)
+{
+  DieTreeFill *fill = data;
+  gint64 deadline = g_get_monotonic_time () + DIE_TREE_FILL_BUDGET_US;
+
+  if (!fill->gathered)
+    {
+      if (!die_tree_fill_step (fill, deadline))
+        {
+          /* Update the count shown by the placeholder.  */
+          GtkTreeIter iter;
+          die_tree_model_set_iter (fill->model, &iter, fill->node, 0);
+          GtkTreePath *path = die_tree_model_node_path (fill->node);
+          gtk_tree_path_append_index (path, 0);
+          gtk_tree_model_row_changed (GTK_TREE_MODEL (fill->model), path,
+                                      &iter);
+          gtk_tree_path_free (path);
+          return G_SOURCE_CONTINUE;
+        }
+      die_tree_model_fill_swap (fill->model, fill->node);
+    }
+
+  if (!die_tree_model_fill_insert (fill->model, fill->node, deadline))
+    return G_SOURCE_CONTINUE;
+
+  fill->source_id = 0;
+  die_tree_model_fill_done (fill->model, fill->node);
+  return G_SOURCE_REMOVE;
+}
+
+
+/* Make sure a node has children, though it may still be a placeholder.  */
+static void
+die_tree_model_fill_node (DieTreeModel *model, DieTreeNode *node)
+{
+  if (node->children != NULL)
+    return;
+
+  DieTreeFill *fill = die_tree_fill_new (model, node);
+  die_tree_fill_step (fill, G_MAXINT64);
+  node->children = fill->children;
+  fill->children = NULL;
+  die_tree_fill_free (fill);
+  PROFILE_COUNT (PROFILE_ROWS_INSERTED, node->children->len);
+}
+
+
+/* Make sure a node has all of its real children, waiting for nothing.  */
+static void
+die_tree_model_finish_node (DieTreeModel *model, DieTreeNode *node)
+{
+  if (node->fill != NULL)
+    {
+      if (!node->fill->gathered)
+        {
+          die_tree_fill_step (node->fill, G_MAXINT64);
+          die_tree_model_fill_swap (model, node);
+        }
+      die_tree_model_fill_insert (model, node, G_MAXINT64);
+      die_tree_model_fill_done (model, node);
+    }
+  die_tree_model_fill_node (model, node);
+}
+
+
+gboolean
+die_tree_model_get_die (DieTreeModel *model, GtkTreeIter *iter,
+                        Dwarf_Die *die)
+{
+  DieTreeNode *node = die_tree_model_iter_node (model, iter);
+  if (node == NULL)
+    return FALSE;
+
+  Dwarf_Off offset = die_tree_node_child (node,
+                                          die_tree_model_iter_index (iter));
+  return (offset != DIE_TREE_PLACEHOLDER
+          && die_tree_model_decode (model, offset, die, NULL));
+}
+
+
+/* Compute the name column for a row, preferring rendered C type names.  */
+static gchar *
+die_tree_model_name (DieTreeModel *model, DieTreeNode *node, guint index,
+                     Dwarf_Die *die)
+{
+  /* Units are named directly, with a signature fallback for types.  */
+  if (node == &model->root)
+    {
+      const char *name = dwarf_diename (die) ?: split_unit_dwo_name (die);
+      if (name != NULL || !model->types)
+        return g_strdup (name);
+      return g_strdup_printf ("{%016" G_GINT64_MODIFIER "x}",
+                              g_array_index (model->signatures,
+                                             uint64_t, index));
+    }
+
+  CuInfo *cu = cu_info_lookup (model->session, die);
+  if (cu != NULL)
+    switch (cu->language) {
+        case DW_LANG_C:
+        case DW_LANG_C89:
+        case DW_LANG_C99:
+        case DW_LANG_C11:
+        case DW_LANG_C_plus_plus:
+        case DW_LANG_C_plus_plus_11:
+        case DW_LANG_C_plus_plus_14:
+          {
+            const char *typename = die_typename (model->session, die);
+            if (typename != NULL)
+              return g_strdup (typename);
+          }
+          break;
+    }
+
+  return g_strdup (dwarf_diename (die));
+}
+
+
+static GtkTreeModelFlags
+die_tree_model_get_flags (G_GNUC_UNUSED GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+
+static gint
+die_tree_model_get_n_columns (G_GNUC_UNUSED GtkTreeModel *tree_model)
+{
+  return DIE_TREE_N_COLUMNS;
+}
+
+
+static GType
+die_tree_model_get_column_type (G_GNUC_UNUSED GtkTreeModel *tree_model,
+                                gint index)
+{
+  switch (index)
+    {
+    case DIE_TREE_COL_OFFSET:
+      return G_TYPE_UINT64;
+    case DIE_TREE_COL_TAG:
+      return G_TYPE_INT;
+    case DIE_TREE_COL_NAME:
+      return G_TYPE_STRING;
+    case DIE_TREE_INT_DIE:
+      return G_TYPE_DWARF_DIE;
+    default:
+      g_return_val_if_reached (G_TYPE_INVALID);
+    }
+}
+
+
+static gboolean
+die_tree_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                         GtkTreePath *path)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  gint depth = gtk_tree_path_get_depth (path);
+  gint *indices = gtk_tree_path_get_indices (path);
+
+  DieTreeNode *node = &model->root;
+  for (gint i = 0; i < depth - 1; ++i)
+    {
+      if (node->children == NULL || (guint) indices[i] >= node->children->len)
+        return FALSE;
+      node = die_tree_node_get_child (node, indices[i], TRUE);
+      die_tree_model_fill_node (model, node);
+    }
+
+  return depth > 0 && die_tree_model_set_iter (model, iter, node,
+                                               indices[depth - 1]);
+}
+
+
+static GtkTreePath *
+die_tree_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  DieTreeNode *node = die_tree_model_iter_node (model, iter);
+  g_return_val_if_fail (node != NULL, NULL);
+
+  GtkTreePath *path = die_tree_model_node_path (node);
+  gtk_tree_path_append_index (path, die_tree_model_iter_index (iter));
+  return path;
+}
+
+
+static void
+die_tree_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                          gint column, GValue *value)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  g_value_init (value, die_tree_model_get_column_type (tree_model, column));
+
+  DieTreeNode *node = die_tree_model_iter_node (model, iter);
+  if (node != NULL && node->fill != NULL && !node->fill->gathered
+      && column == DIE_TREE_COL_NAME)
+    {
+      g_value_take_string (value, g_strdup_printf ("Loading %u children...",
+                                                   node->fill->children->len));
+      return;
+    }
+
+  Dwarf_Die die;
+  if (!die_tree_model_get_die (model, iter, &die))
+    return;
+
+  switch (column)
+    {
+    case DIE_TREE_COL_OFFSET:
+      g_value_set_uint64 (value, dwarf_dieoffset (&die));
+      break;
+
+    case DIE_TREE_COL_TAG:
+      g_value_set_int (value, dwarf_tag (&die));
+      break;
+
+    case DIE_TREE_COL_NAME:
+      g_value_take_string (value,
+                           die_tree_model_name (model, iter->user_data,
+                                                die_tree_model_iter_index (iter),
+                                                &die));
+      break;
+
+    case DIE_TREE_INT_DIE:
+      g_value_set_boxed (value, &die);
+      break;
+    }
+}
+
+
+static gboolean
+die_tree_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  DieTreeNode *node = die_tree_model_iter_node (model, iter);
+  return node != NULL
+    && die_tree_model_set_iter (model, iter, node,
+                                die_tree_model_iter_index (iter) + 1);
+}
+
+
+static gboolean
+die_tree_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                               GtkTreeIter *parent, gint n)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  DieTreeNode *node = &model->root;
+  if (parent != NULL)
+    {
+      DieTreeNode *pnode = die_tree_model_iter_node (model, parent);
+      if (pnode == NULL)
+        return FALSE;
+      node = die_tree_node_get_child (pnode, die_tree_model_iter_index (parent),
+                                      TRUE);
+      die_tree_model_fill_node (model, node);
+    }
+
+  return n >= 0 && die_tree_model_set_iter (model, iter, node, n);
+}
+
+
+static gboolean
+die_tree_model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                              GtkTreeIter *parent)
+{
+  return die_tree_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+
+static gint
+die_tree_model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  DieTreeNode *node = &model->root;
+  if (iter != NULL)
+    {
+      DieTreeNode *pnode = die_tree_model_iter_node (model, iter);
+      if (pnode == NULL)
+        return 0;
+      node = die_tree_node_get_child (pnode, die_tree_model_iter_index (iter),
+                                      TRUE);
+      die_tree_model_fill_node (model, node);
+    }
+
+  return node->children->len;
+}
+
+
+static gboolean
+die_tree_model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  DieTreeNode *pnode = die_tree_model_iter_node (model, iter);
+  if (pnode == NULL)
+    return FALSE;
+
+  /* If it's been filled, we know for sure.  */
+  guint index = die_tree_model_iter_index (iter);
+  DieTreeNode *node = die_tree_node_get_child (pnode, index, FALSE);
+  if (node != NULL && node->children != NULL)
+    return node->children->len > 0;
+
+  /* Otherwise guess from the DIE, without filling anything.  */
+  Dwarf_Die die, import;
+  if (!die_tree_model_get_die (model, iter, &die))
+    return FALSE;
+  if (dwarf_haschildren (&die) || split_unit_dwo_name (&die) != NULL)
+    return TRUE;
+  return model->session->nested_imports && dwarf_die_import (&die, &import);
+}
+
+
+static gboolean
+die_tree_model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                            GtkTreeIter *child)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (tree_model);
+  DieTreeNode *node = die_tree_model_iter_node (model, child);
+  if (node == NULL || node->parent == NULL)
+    return FALSE;
+
+  return die_tree_model_set_iter (model, iter, node->parent, node->index);
+}
+
+
+static void
+die_tree_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = die_tree_model_get_flags;
+  iface->get_n_columns = die_tree_model_get_n_columns;
+  iface->get_column_type = die_tree_model_get_column_type;
+  iface->get_iter = die_tree_model_get_iter;
+  iface->get_path = die_tree_model_get_path;
+  iface->get_value = die_tree_model_get_value;
+  iface->iter_next = die_tree_model_iter_next;
+  iface->iter_children = die_tree_model_iter_children;
+  iface->iter_has_child = die_tree_model_iter_has_child;
+  iface->iter_n_children = die_tree_model_iter_n_children;
+  iface->iter_nth_child = die_tree_model_iter_nth_child;
+  iface->iter_parent = die_tree_model_iter_parent;
+}
+
+
+static void
+die_tree_imports_free (gpointer data)
+{
+  g_array_free (data, TRUE);
+}
+
+
+static void
+die_tree_model_init (DieTreeModel *model)
+{
+  model->stamp = g_random_int ();
+  model->root.children = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+  model->imports = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, die_tree_imports_free);
+}
+
+
+static void
+die_tree_model_finalize (GObject *object)
+{
+  DieTreeModel *model = DIE_TREE_MODEL (object);
+
+  g_array_free (model->root.children, TRUE);
+  if (model->root.nodes != NULL)
+    g_hash_table_destroy (model->root.nodes);
+  if (model->signatures != NULL)
+    g_array_free (model->signatures, TRUE);
+  g_hash_table_destroy (model->imports);
+
+  G_OBJECT_CLASS (die_tree_model_parent_class)->finalize (object);
+}
+
+
+static void
+die_tree_model_class_init (DieTreeModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  object_class->finalize = die_tree_model_finalize;
+
+  /* Emitted with the path of a row whose children finished loading in the
+   * background, since the view collapsed it when the placeholder went.  */
+  die_tree_model_signals[CHILDREN_LOADED] =
+    g_signal_new ("children-loaded", G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                  g_cclosure_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1, GTK_TYPE_TREE_PATH);
+}
+
+
+DieTreeModel *
+die_tree_model_new (DwarvishSession *session, gboolean types)
+{
+  DieTreeModel *model = g_object_new (DIE_TYPE_TREE_MODEL, NULL);
+  model->session = session;
+  model->types = types;
+  if (types)
+    model->signatures = g_array_new (FALSE, FALSE, sizeof (uint64_t));
+  g_object_set_data (G_OBJECT (model), "DwarvishSession", session);
+  return model;
+}
+
+
+/* Whether this is the view of .debug_types.  */
+gboolean
+die_tree_model_get_types (DieTreeModel *model)
+{
+  return model->types;
+}
+
+
+/* Add a unit's DIE as a new top-level row.  */
+void
+die_tree_model_append_unit (DieTreeModel *model, Dwarf_Die *die,
+                            uint64_t type_signature)
+{
+  Dwarf_Off offset = die_tree_model_encode (model, die, model->types);
+  g_array_append_val (model->root.children, offset);
+  if (model->types)
+    g_array_append_val (model->signatures, type_signature);
+  PROFILE_COUNT (PROFILE_ROWS_INSERTED, 1);
+
+  GtkTreeIter iter;
+  GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
+  die_tree_model_set_iter (model, &iter, &model->root,
+                           model->root.children->len - 1);
+  GtkTreePath *path = die_tree_model_get_path (tree_model, &iter);
+  gtk_tree_model_row_inserted (tree_model, path, &iter);
+  if (die_tree_model_iter_has_child (tree_model, &iter))
+    gtk_tree_model_row_has_child_toggled (tree_model, path, &iter);
+  gtk_tree_path_free (path);
+}
+
+
+/* Fill in the children of a row, returning whether there are any.  If it
+ * takes too long, the rest are gathered in the background behind a
+ * placeholder row, and "children-loaded" is emitted when they're ready.  */
+gboolean
+die_tree_model_expand (DieTreeModel *model, GtkTreeIter *iter)
+{
+  DieTreeNode *pnode = die_tree_model_iter_node (model, iter);
+  g_return_val_if_fail (pnode != NULL, FALSE);
+
+  DieTreeNode *node = die_tree_node_get_child (pnode,
+                                               die_tree_model_iter_index (iter),
+                                               TRUE);
+  if (node->children == NULL)
+    {
+      gint64 start = profile_begin ();
+      DieTreeFill *fill = die_tree_fill_new (model, node);
+      if (!die_tree_fill_step (fill, (g_get_monotonic_time ()
+                                      + DIE_TREE_FILL_BUDGET_US)))
+        {
+          Dwarf_Off placeholder = DIE_TREE_PLACEHOLDER;
+          node->children = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+          g_array_append_val (node->children, placeholder);
+          node->fill = fill;
+          fill->source_id = g_idle_add (die_tree_fill_idle, fill);
+          profile_end (start, "expand row");
+          return TRUE;
+        }
+
+      node->children = fill->children;
+      fill->children = NULL;
+      die_tree_fill_free (fill);
+      PROFILE_COUNT (PROFILE_ROWS_INSERTED, node->children->len);
+      profile_end (start, "expand row");
+    }
+
+  if (node->children->len > 0)
+    return TRUE;
+
+  /* We may have claimed children before, but it must have been empty
+   * imports.  Let the view know there's nothing here after all.  */
+  GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
+  GtkTreePath *path = die_tree_model_get_path (tree_model, iter);
+  gtk_tree_model_row_has_child_toggled (tree_model, path, iter);
+  gtk_tree_path_free (path);
+  return FALSE;
+}
+
+
+static int
+die_tree_offset_compare (const void *a, const void *b)
+{
+  Dwarf_Off x = *(const Dwarf_Off *) a, y = *(const Dwarf_Off *) b;
+  return (x > y) - (x < y);
+}
+
+
+static gint
+die_tree_order_compare (gconstpointer a, gconstpointer b, gpointer data)
+{
+  GArray *children = data;
+  Dwarf_Off x = g_array_index (children, Dwarf_Off, *(const guint *) a);
+  Dwarf_Off y = g_array_index (children, Dwarf_Off, *(const guint *) b);
+  return (x > y) - (x < y);
+}
+
+
+/* Find the first child row with an encoded offset.  Children come in DIE
+ * order, so they're already sorted unless imports were spliced in from
+ * other units, and only then is a sorted index of them built, the first
+ * time one is looked up.  An empty index means the children are sorted.  */
+static gint
+die_tree_node_find_child (DieTreeNode *node, Dwarf_Off offset)
+{
+  guint n = node->children->len;
+  if (node->order == NULL)
+    {
+      node->order = g_array_new (FALSE, FALSE, sizeof (guint));
+      guint i = 1;
+      while (i < n && (die_tree_node_child (node, i - 1)
+                       <= die_tree_node_child (node, i)))
+        ++i;
+      if (i < n)
+        {
+          g_array_set_size (node->order, n);
+          for (i = 0; i < n; ++i)
+            g_array_index (node->order, guint, i) = i;
+          /* This is a stable sort, so duplicates keep their order.  */
+          g_qsort_with_data (node->order->data, n, sizeof (guint),
+                             die_tree_order_compare, node->children);
+        }
+    }
+
+  const guint *order = node->order->len ? (const guint *) node->order->data
+    : NULL;
+  guint lo = 0, hi = n;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      if (die_tree_node_child (node, order ? order[mid] : mid) < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == n)
+    return -1;
+  guint index = order ? order[lo] : lo;
+  return die_tree_node_child (node, index) == offset ? (gint) index : -1;
+}
+
+
+/* Append the index of a DIE among the children at the given path.  */
+static GtkTreePath *
+die_tree_model_child_path (DieTreeModel *model, GtkTreePath *path,
+                           Dwarf_Die *die, gboolean types)
+{
+  Dwarf_Off offset = die_tree_model_encode (model, die, types);
+  DieTreeNode *node = &model->root;
+  gint index = -1;
+
+  if (gtk_tree_path_get_depth (path) == 0)
+    {
+      /* Units are added in offset order, so the root is sorted.  */
+      Dwarf_Off *found = bsearch (&offset, node->children->data,
+                                  node->children->len, sizeof (Dwarf_Off),
+                                  die_tree_offset_compare);
+      if (found != NULL)
+        index = found - (Dwarf_Off *) node->children->data;
+    }
+  else
+    {
+      GtkTreeIter iter;
+      if (die_tree_model_get_iter (GTK_TREE_MODEL (model), &iter, path))
+        {
+          node = die_tree_node_get_child (iter.user_data,
+                                          die_tree_model_iter_index (&iter),
+                                          TRUE);
+          die_tree_model_finish_node (model, node);
+          index = die_tree_node_find_child (node, offset);
+        }
+    }
+
+  if (index < 0)
+    {
+      gtk_tree_path_free (path);
+      return NULL;
+    }
+
+  gtk_tree_path_append_index (path, index);
+  return path;
+}
+
+
+static GtkTreePath *die_tree_model_die_path (DieTreeModel *model,
+                                             Dwarf_Die *die, gboolean types,
+                                             Dwarf_Die *hint);
+
+/* Find the path of the row under which a DIE's children are shown.  For
+ * flattened partial units that's wherever their importer's siblings are.  */
+static GtkTreePath *
+die_tree_model_children_path (DieTreeModel *model, Dwarf_Die *die,
+                              gboolean types, Dwarf_Die *hint)
+{
+  DwarvishSession *session = model->session;
+  if (!session->explicit_imports && !session->nested_imports
+      && dwarf_tag (die) == DW_TAG_partial_unit)
+    {
+      Dwarf_Die importer, parent;
+      if (!die_index_get_importer (session, die, hint, &importer)
+          || !die_index_get_parent (session, &importer, FALSE, &parent))
+        return NULL;
+      return die_tree_model_children_path (model, &parent, FALSE, hint);
+    }
+
+  return die_tree_model_die_path (model, die, types, hint);
+}
+
+
+/* Find the path of the row showing a DIE.  */
+static GtkTreePath *
+die_tree_model_die_path (DieTreeModel *model, Dwarf_Die *die,
+                         gboolean types, Dwarf_Die *hint)
+{
+  DwarvishSession *session = model->session;
+
+  Dwarf_Die parent;
+  if (die_index_get_parent (session, die, types, &parent))
+    {
+      GtkTreePath *path = die_tree_model_children_path (model, &parent,
+                                                        types, hint);
+      return path ? die_tree_model_child_path (model, path, die, types) : NULL;
+    }
+
+  /* Split units are shown by their skeleton rows.  */
+  Dwarf_Die skeleton;
+  if (split_unit_skeleton (session, die, &skeleton))
+    return die_tree_model_child_path (model, gtk_tree_path_new (),
+                                      &skeleton, FALSE);
+
+  /* Units are at the root, except partial units without explicit imports.
+   * Nested imports show those under their imported_unit instead.  */
+  if (session->explicit_imports || dwarf_tag (die) != DW_TAG_partial_unit)
+    return die_tree_model_child_path (model, gtk_tree_path_new (),
+                                      die, types);
+
+  Dwarf_Die importer;
+  if (!session->nested_imports
+      || !die_index_get_importer (session, die, hint, &importer))
+    return NULL;
+
+  GtkTreePath *path = die_tree_model_die_path (model, &importer,
+                                               FALSE, hint);
+  if (path != NULL)
+    gtk_tree_path_append_index (path, 0);
+  return path;
+}
+
+
+/* Find the path to any DIE, expanding only its ancestors.  Where there's a
+ * choice of imports, prefer those in the same unit as the hint row.  */
+GtkTreePath *
+die_tree_model_find_die (DieTreeModel *model, Dwarf_Die *die,
+                         GtkTreeIter *hint)
+{
+  Dwarf_Die hint_unit, *phint_unit = NULL;
+  if (hint != NULL)
+    {
+      DieTreeNode *node = die_tree_model_iter_node (model, hint);
+      guint index = die_tree_model_iter_index (hint);
+      for (; node != NULL && node->parent != NULL; node = node->parent)
+        index = node->index;
+      if (node != NULL && die_tree_model_decode (model,
+                                                 die_tree_node_child (node,
+                                                                      index),
+                                                 &hint_unit, NULL))
+        phint_unit = &hint_unit;
+    }
+
+  /* Only the types view has .debug_types, and only from the main file.  */
+  gboolean types = (model->types
+                    && dwarf_cu_getdwarf (die->cu) == model->session->dwarf);
+  return die_tree_model_die_path (model, die, types, phint_unit);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,72 @@
+/*
+ * die-tree model interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _DIETREEMODEL_H_
+#define _DIETREEMODEL_H_
+
+#include <elfutils/libdw.h>
+#include <gtk/gtk.h>
+
+#include "session.h"
+
+
+/* The offset and tag are numeric, and only formatted when drawn.  */
+enum
+{
+  DIE_TREE_COL_OFFSET = 0,      /* guint64 */
+  DIE_TREE_COL_TAG,             /* gint */
+  DIE_TREE_COL_NAME,
+  DIE_TREE_INT_DIE,
+  DIE_TREE_N_COLUMNS
+};
+
+
+typedef struct _DieTreeModel DieTreeModel;
+typedef struct _DieTreeModelClass DieTreeModelClass;
+
+G_GNUC_INTERNAL GType die_tree_model_get_type (void);
+#define DIE_TYPE_TREE_MODEL (die_tree_model_get_type ())
+#define DIE_TREE_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), DIE_TYPE_TREE_MODEL, DieTreeModel))
+#define DIE_IS_TREE_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), DIE_TYPE_TREE_MODEL))
+
+
+G_GNUC_INTERNAL
+DieTreeModel *die_tree_model_new (DwarvishSession *session,
+                                  gboolean types);
+
+G_GNUC_INTERNAL
+gboolean die_tree_model_get_types (DieTreeModel *model);
+
+G_GNUC_INTERNAL
+void die_tree_model_append_unit (DieTreeModel *model,
+                                 Dwarf_Die *die,
+                                 uint64_t type_signature);
+
+G_GNUC_INTERNAL
+gboolean die_tree_model_get_die (DieTreeModel *model,
+                                 GtkTreeIter *iter,
+                                 Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+gboolean die_tree_model_expand (DieTreeModel *model,
+                                GtkTreeIter *iter);
+
+G_GNUC_INTERNAL
+GtkTreePath *die_tree_model_find_die (DieTreeModel *model,
+                                      Dwarf_Die *die,
+                                      GtkTreeIter *hint);
+
+
+#endif /* _DIETREEMODEL_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
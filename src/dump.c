@@ -0,0 +1,407 @@
+/*
+ * Headless dump implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dwarf.h>
+
+#include "dump.h"
+#include "attrtree.h"
+#include "dietreemodel.h"
+#include "dwstring.h"
+#include "profile.h"
+#include "typename.h"
+
+
+/* Each unit is walked through its own die tree model, so the rows and
+ * names are exactly what the views show, and rendered into a buffer of its
+ * own.  Workers claim units in order, but may run only a few units ahead of
+ * the output, so memory stays bounded however big the file is.  Every
+ * worker past the first begins its own clone of the session on its own
+ * thread, since libdw handles and the session caches are not shared
+ * between threads.  Clones share the file's data, but each has its own
+ * caches, so the type name budget is split between the workers, and only
+ * a few are used unless more are asked for.  */
+#define DUMP_MAX_JOBS 16
+#define DUMP_DEFAULT_JOBS 4
+#define DUMP_UNITS_AHEAD 4
+#define DUMP_TYPENAME_MAX_BYTES (64 << 20)
+
+typedef struct _DumpUnit
+{
+  Dwarf_Off offset;
+  uint64_t type_signature;
+  gboolean types;
+} DumpUnit;
+
+typedef struct _Dump
+{
+  DumpFormat format;
+  GArray *units;        /* DumpUnit, in output order.  */
+  guint ahead;          /* How many units may be rendered but unwritten.  */
+  gsize typename_max;   /* Type name bytes each worker may keep.  */
+
+  GMutex lock;
+  GCond cond;
+  guint next_unit;      /* The next unit for a worker to claim.  */
+  guint written;        /* How many units have been written out.  */
+  GString **results;    /* Finished unit i, in slot i % ahead.  */
+  gboolean failed;      /* Output failed, so stop rendering.  */
+} Dump;
+
+typedef struct _DumpWorker
+{
+  Dump *dump;
+  DwarvishSession *session;     /* Shared, or NULL to begin a clone.  */
+  DwarvishSession *parent;
+  GThread *thread;
+} DumpWorker;
+
+typedef struct _DumpAttrs
+{
+  DwarvishSession *session;
+  DumpFormat format;
+  Dwarf_Die *die;
+  guint depth;
+  guint count;
+  GString *out;
+} DumpAttrs;
+
+
+gboolean
+dump_parse_format (const char *name, DumpFormat *format)
+{
+  if (strcmp (name, "text") == 0)
+    *format = DUMP_FORMAT_TEXT;
+  else if (strcmp (name, "json") == 0)
+    *format = DUMP_FORMAT_JSON;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+
+static void
+dump_json_string (GString *out, const char *str)
+{
+  if (str == NULL)
+    {
+      g_string_append (out, "null");
+      return;
+    }
+
+  g_string_append_c (out, '"');
+  for (const unsigned char *s = (const unsigned char *) str; *s; ++s)
+    switch (*s)
+      {
+      case '"':
+        g_string_append (out, "\\\"");
+        break;
+      case '\\':
+        g_string_append (out, "\\\\");
+        break;
+      case '\n':
+        g_string_append (out, "\\n");
+        break;
+      case '\t':
+        g_string_append (out, "\\t");
+        break;
+      default:
+        if (*s < 0x20)
+          g_string_append_printf (out, "\\u%04x", *s);
+        else
+          g_string_append_c (out, *s);
+      }
+  g_string_append_c (out, '"');
+}
+
+
+static int
+dump_attr (Dwarf_Attribute *attr, void *user_data)
+{
+  DumpAttrs *attrs = user_data;
+  GString *out = attrs->out;
+
+  /* Siblings are left out just as in the attr view.  */
+  unsigned int name = dwarf_whatattr (attr);
+  if (name == DW_AT_sibling && !attrs->session->explicit_siblings)
+    return DWARF_CB_OK;
+
+  const char *attribute = DW_AT__name (name);
+  const char *form = DW_FORM__name (dwarf_whatform (attr));
+  gchar *value = attr_tree_value_string (attrs->session, attrs->die, attr);
+  PROFILE_COUNT (PROFILE_ATTRS_RENDERED, 1);
+
+  if (attrs->format == DUMP_FORMAT_JSON)
+    {
+      g_string_append (out, attrs->count++ ? ",{\"attr\":" : "{\"attr\":");
+      dump_json_string (out, attribute);
+      g_string_append (out, ",\"form\":");
+      dump_json_string (out, form);
+      g_string_append (out, ",\"value\":");
+      dump_json_string (out, value);
+      g_string_append_c (out, '}');
+    }
+  else
+    g_string_append_printf (out, "%*s%s %s %s\n", attrs->depth * 2 + 4, "",
+                            attribute, form, value ?: "");
+
+  g_free (value);
+  return DWARF_CB_OK;
+}
+
+
+/* Write a row and its attributes, then all the rows below it.  */
+static void
+dump_row (DumpAttrs *attrs, GtkTreeModel *model, GtkTreeIter *iter,
+          gboolean types)
+{
+  DwarvishSession *session = attrs->session;
+  GString *out = attrs->out;
+
+  Dwarf_Die die;
+  if (!die_tree_model_get_die (DIE_TREE_MODEL (model), iter, &die))
+    return;
+
+  gchar *name = NULL;
+  gtk_tree_model_get (model, iter, DIE_TREE_COL_NAME, &name, -1);
+  const char *tag = DW_TAG__name (dwarf_tag (&die));
+  Dwarf_Off offset = dwarf_dieoffset (&die);
+  gboolean alt = (dwarf_cu_getdwarf (die.cu) != session->dwarf);
+
+  attrs->die = &die;
+  attrs->count = 0;
+  if (attrs->format == DUMP_FORMAT_JSON)
+    {
+      g_string_append_printf (out, "{\"offset\":%" G_GUINT64_FORMAT
+                              ",\"depth\":%u", offset, attrs->depth);
+      if (alt)
+        g_string_append (out, ",\"alt\":true");
+      else if (types)
+        g_string_append (out, ",\"types\":true");
+      g_string_append (out, ",\"tag\":");
+      dump_json_string (out, tag);
+      g_string_append (out, ",\"name\":");
+      dump_json_string (out, name);
+      g_string_append (out, ",\"attrs\":[");
+      dwarf_getattrs (&die, dump_attr, attrs, 0);
+      g_string_append (out, "]}\n");
+    }
+  else
+    {
+      g_string_append_printf (out, "%*s[%s%" G_GINT64_MODIFIER "x] %s %s\n",
+                              attrs->depth * 2, "", alt ? "alt:" : "",
+                              offset, tag, name ?: "");
+      dwarf_getattrs (&die, dump_attr, attrs, 0);
+    }
+  g_free (name);
+
+  GtkTreeIter child;
+  if (gtk_tree_model_iter_children (model, &child, iter))
+    {
+      ++attrs->depth;
+      do
+        dump_row (attrs, model, &child, types);
+      while (gtk_tree_model_iter_next (model, &child));
+      --attrs->depth;
+    }
+}
+
+
+static GString *
+dump_unit (DwarvishSession *session, const Dump *dump, const DumpUnit *unit)
+{
+  DumpAttrs attrs;
+  attrs.session = session;
+  attrs.format = dump->format;
+  attrs.depth = 0;
+  attrs.out = g_string_new (NULL);
+  gint64 start = profile_begin ();
+
+  Dwarf_Die die;
+  typeof (dwarf_offdie) *offdie = unit->types ? dwarf_offdie_types
+    : dwarf_offdie;
+  if (offdie (session->dwarf, unit->offset, &die) == NULL)
+    return attrs.out;
+
+  DieTreeModel *model = die_tree_model_new (session, unit->types);
+  die_tree_model_append_unit (model, &die, unit->type_signature);
+
+  GtkTreeIter iter;
+  if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model), &iter))
+    dump_row (&attrs, GTK_TREE_MODEL (model), &iter, unit->types);
+
+  /* The model's rows go with it, but type names are kept for later units
+   * until there are too many.  */
+  g_object_unref (model);
+  die_typename_trim (session, dump->typename_max);
+  profile_end (start, "dump unit");
+  return attrs.out;
+}
+
+
+/* List the units just as the views do, so partial units are only at the
+ * top level with explicit imports.  */
+static void
+dump_list_units (DwarvishSession *session, gboolean types, GArray *units)
+{
+  typeof (dwarf_offdie) *offdie = types ? dwarf_offdie_types : dwarf_offdie;
+
+  DumpUnit unit = { 0, 0, types };
+  size_t cuhl;
+  for (Dwarf_Off noff, off = 0;
+       dwarf_next_unit (session->dwarf, off, &noff, &cuhl, NULL, NULL, NULL,
+                        NULL, types ? &unit.type_signature : NULL, NULL) == 0;
+       off = noff)
+    {
+      Dwarf_Die die;
+      unit.offset = off + cuhl;
+      if (offdie (session->dwarf, unit.offset, &die) == NULL
+          || (!session->explicit_imports
+              && dwarf_tag (&die) == DW_TAG_partial_unit))
+        continue;
+      g_array_append_val (units, unit);
+    }
+}
+
+
+static gpointer
+dump_worker_thread (gpointer data)
+{
+  DumpWorker *worker = data;
+  Dump *dump = worker->dump;
+
+  DwarvishSession *session = worker->session;
+  if (session == NULL)
+    {
+      const char *error;
+      session = session_clone (worker->parent, &error);
+      if (session == NULL)
+        {
+          /* The other workers, at least the first, still take its share.  */
+          g_printerr ("%s: %s\n", g_get_application_name (), error);
+          return NULL;
+        }
+    }
+
+  g_mutex_lock (&dump->lock);
+  for (;;)
+    {
+      while (!dump->failed && dump->next_unit < dump->units->len
+             && dump->next_unit >= dump->written + dump->ahead)
+        g_cond_wait (&dump->cond, &dump->lock);
+      if (dump->failed || dump->next_unit >= dump->units->len)
+        break;
+
+      guint i = dump->next_unit++;
+      g_mutex_unlock (&dump->lock);
+      GString *out = dump_unit (session, dump,
+                                &g_array_index (dump->units, DumpUnit, i));
+      g_mutex_lock (&dump->lock);
+
+      dump->results[i % dump->ahead] = out;
+      g_cond_broadcast (&dump->cond);
+    }
+  g_mutex_unlock (&dump->lock);
+
+  if (session != worker->session)
+    session_end (session);
+  return NULL;
+}
+
+
+/* Write each unit as soon as it and all before it are done.  */
+static gboolean
+dump_write_units (Dump *dump)
+{
+  for (guint i = 0; i < dump->units->len; ++i)
+    {
+      g_mutex_lock (&dump->lock);
+      while (dump->results[i % dump->ahead] == NULL)
+        g_cond_wait (&dump->cond, &dump->lock);
+      GString *out = dump->results[i % dump->ahead];
+      dump->results[i % dump->ahead] = NULL;
+      g_mutex_unlock (&dump->lock);
+
+      gboolean ok = (fwrite (out->str, 1, out->len, stdout) == out->len);
+      g_string_free (out, TRUE);
+
+      g_mutex_lock (&dump->lock);
+      dump->written = i + 1;
+      dump->failed = !ok;
+      g_cond_broadcast (&dump->cond);
+      g_mutex_unlock (&dump->lock);
+      if (!ok)
+        return FALSE;
+    }
+
+  return fflush (stdout) == 0;
+}
+
+
+/* Dump all of .debug_info and then .debug_types to stdout, using up to the
+ * given number of threads, or one per CPU up to a few for 0.  */
+gboolean
+dump_session (DwarvishSession *session, DumpFormat format, guint jobs)
+{
+  if (jobs == 0)
+    {
+      long n = sysconf (_SC_NPROCESSORS_ONLN);
+      jobs = CLAMP (n, 1, DUMP_DEFAULT_JOBS);
+    }
+  jobs = MIN (jobs, DUMP_MAX_JOBS);
+
+  Dump dump;
+  memset (&dump, 0, sizeof dump);
+  dump.format = format;
+  dump.units = g_array_new (FALSE, FALSE, sizeof (DumpUnit));
+  dump_list_units (session, FALSE, dump.units);
+  dump_list_units (session, TRUE, dump.units);
+  jobs = CLAMP (jobs, 1, MAX (dump.units->len, 1));
+
+  dump.ahead = jobs * DUMP_UNITS_AHEAD;
+  dump.typename_max = DUMP_TYPENAME_MAX_BYTES / jobs;
+  dump.results = g_new0 (GString *, dump.ahead);
+  g_mutex_init (&dump.lock);
+  g_cond_init (&dump.cond);
+
+  /* The first worker shares this session, which is otherwise idle.  */
+  DumpWorker workers[DUMP_MAX_JOBS];
+  for (guint i = 0; i < jobs; ++i)
+    {
+      workers[i].dump = &dump;
+      workers[i].session = (i == 0) ? session : NULL;
+      workers[i].parent = session;
+      workers[i].thread = g_thread_new ("dwarvish-dump", dump_worker_thread,
+                                        &workers[i]);
+    }
+
+  gboolean ok = dump_write_units (&dump);
+
+  for (guint i = 0; i < jobs; ++i)
+    g_thread_join (workers[i].thread);
+
+  for (guint i = 0; i < dump.ahead; ++i)
+    if (dump.results[i] != NULL)
+      g_string_free (dump.results[i], TRUE);
+  g_free (dump.results);
+  g_mutex_clear (&dump.lock);
+  g_cond_clear (&dump.cond);
+  g_array_free (dump.units, TRUE);
+  return ok;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,39 @@
+/*
+ * Headless dump interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _DUMP_H_
+#define _DUMP_H_
+
+#include <glib.h>
+
+#include "session.h"
+
+
+typedef enum
+{
+  DUMP_FORMAT_TEXT = 0,
+  DUMP_FORMAT_JSON
+} DumpFormat;
+
+
+G_GNUC_INTERNAL
+gboolean dump_parse_format (const char *name,
+                            DumpFormat *format);
+
+G_GNUC_INTERNAL
+gboolean dump_session (DwarvishSession *session,
+                       DumpFormat format,
+                       guint jobs);
+
+
+#endif /* _DUMP_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
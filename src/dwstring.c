@@ -12,11 +12,65 @@
 # include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <dwarf.h>
 #include "dwstring.h"
 
-#define ONE_KNOWN_DW_DESC(name, code, desc) \
-  ONE_KNOWN_DW (name, code)
+
+/* Names are looked up in tables generated by known-dwarf.awk: codes below
+ * 256 index a dense array, larger vendor codes are binary searched, and a
+ * switch catches any whose value the script couldn't read.  */
+typedef struct _DwName
+{
+  int code;
+  const char *name;
+} DwName;
+
+
+static int
+dw_name_compare (const void *key, const void *elt)
+{
+  int code = *(const int *) key;
+  const DwName *entry = elt;
+  return (code > entry->code) - (code < entry->code);
+}
+
+
+/* Unknown codes are rendered once and interned, so no name needs freeing.  */
+static const char *
+dw_unknown_name (int code)
+{
+  char buf[16];
+  g_snprintf (buf, sizeof buf, "%#x", code);
+  return g_intern_string (buf);
+}
+
+
+#define ONE_KNOWN_DW(name, code) \
+  [code] = #name,
+
+#define ONE_KNOWN_DW_SET(set)                           \
+  static const char *const DW_##set##__dense[256] =     \
+    { ALL_KNOWN_DW_##set##_DENSE };
+
+ALL_KNOWN_DW_SETS
+
+#undef ONE_KNOWN_DW_SET
+#undef ONE_KNOWN_DW
+
+
+#define ONE_KNOWN_DW(name, code) \
+  { code, #name },
+
+#define ONE_KNOWN_DW_SET(set)                           \
+  static const DwName DW_##set##__sparse[] =            \
+    { ALL_KNOWN_DW_##set##_SPARSE { 0, NULL } };
+
+ALL_KNOWN_DW_SETS
+
+#undef ONE_KNOWN_DW_SET
+#undef ONE_KNOWN_DW
+
 
 #define ONE_KNOWN_DW(name, code) \
   case code: return #name;
@@ -31,23 +85,43 @@
     return g_strdup_printf (format, code);              \
   }
 
-#define ONE_KNOWN_DW_SET(set)   \
-  const char *                  \
-  DW_##set##__string (int code) \
-  {                             \
-    switch (code)               \
-      {                         \
-      ALL_KNOWN_DW_##set        \
-      default: return NULL;     \
-      }                         \
-  }                             \
+#define ONE_KNOWN_DW_SET(set)                                           \
+  const char *                                                          \
+  DW_##set##__string (int code)                                         \
+  {                                                                     \
+    if (code >= 0 && code < (int) G_N_ELEMENTS (DW_##set##__dense)      \
+        && DW_##set##__dense[code] != NULL)                             \
+      return DW_##set##__dense[code];                                   \
+                                                                        \
+    const DwName *entry =                                               \
+      bsearch (&code, DW_##set##__sparse,                               \
+               G_N_ELEMENTS (DW_##set##__sparse) - 1,                   \
+               sizeof (DwName), dw_name_compare);                       \
+    if (entry != NULL)                                                  \
+      return entry->name;                                               \
+                                                                        \
+    switch (code)                                                       \
+      {                                                                 \
+      ALL_KNOWN_DW_##set##_SLOW                                         \
+      default: return NULL;                                             \
+      }                                                                 \
+  }                                                                     \
+                                                                        \
+  const char *                                                          \
+  DW_##set##__name (int code)                                           \
+  {                                                                     \
+    const char *str = DW_##set##__string (code);                        \
+    if (G_LIKELY (str != NULL))                                         \
+      return str;                                                       \
+    return dw_unknown_name (code);                                      \
+  }                                                                     \
+                                                                        \
   DW_STRDUP_FN (set, hex, "%#x")
 
 ALL_KNOWN_DW_SETS
 
 #undef ONE_KNOWN_DW_SET
 #undef ONE_KNOWN_DW
-#undef ONE_KNOWN_DW_DESC
 
 
 /* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -14,8 +14,11 @@
 #include <glib.h>
 #include "known-dwarf.h"
 
+/* DW_*__string returns NULL for unknown codes, DW_*__name a static or
+ * interned hex string instead, and DW_*__strdup_hex a copy of either.  */
 #define ONE_KNOWN_DW_SET(set) \
   G_GNUC_INTERNAL const char *DW_##set##__string (int code); \
+  G_GNUC_INTERNAL const char *DW_##set##__name (int code); \
   G_GNUC_INTERNAL char *DW_##set##__strdup_hex (int code);
 
 ALL_KNOWN_DW_SETS
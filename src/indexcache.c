@@ -0,0 +1,261 @@
+/*
+ * On-disk index cache implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "indexcache.h"
+#include "nameindex.h"
+#include "profile.h"
+
+
+/* Indexes built for a file are saved under $XDG_CACHE_HOME/dwarvish, one
+ * file each for .debug_info and .debug_types, named by the module's
+ * build-id.  The debug file's mtime and size are checked as well, in case
+ * it was rebuilt without a new build-id.  Every section is a flat array
+ * in native byte order, so a cache is used straight from its mapping.  */
+#define INDEX_CACHE_MAGIC "DWVSHIDX"
+#define INDEX_CACHE_VERSION 2
+#define INDEX_CACHE_BYTE_ORDER 0x01020304
+#define INDEX_CACHE_MAX_BUILD_ID 64
+#define INDEX_CACHE_ALIGN 8
+
+typedef struct _IndexCacheHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint64 mtime;
+  guint64 size;
+  guint32 build_id_len;
+  guint8 build_id[INDEX_CACHE_MAX_BUILD_ID];
+  guint32 reserved;
+  struct
+  {
+    guint64 offset;
+    guint64 count;
+  } sections[INDEX_CACHE_N_SECTIONS];
+} IndexCacheHeader;
+
+struct _IndexCache
+{
+  gchar *path;
+  IndexCacheHeader key;         /* Just the identifying fields.  */
+  GMappedFile *map;             /* If a valid cache was found.  */
+};
+
+
+static const gsize index_cache_elem_sizes[INDEX_CACHE_N_SECTIONS] =
+{
+  [INDEX_CACHE_UNITS] = sizeof (IndexCacheUnit),
+  [INDEX_CACHE_NAMES] = sizeof (NameEntry),
+  [INDEX_CACHE_NAME_FIRSTS] = sizeof (guint32),
+  [INDEX_CACHE_STRINGS] = sizeof (char),
+  [INDEX_CACHE_PARENTS] = sizeof (IndexCacheParent),
+};
+
+
+static gboolean
+index_cache_validate (IndexCache *cache, const gchar *contents, gsize length)
+{
+  const IndexCacheHeader *header = (const IndexCacheHeader *) contents;
+  if (length < sizeof (IndexCacheHeader)
+      || memcmp (header->magic, INDEX_CACHE_MAGIC, sizeof header->magic)
+      || header->version != INDEX_CACHE_VERSION
+      || header->byte_order != INDEX_CACHE_BYTE_ORDER
+      || header->mtime != cache->key.mtime
+      || header->size != cache->key.size
+      || header->build_id_len != cache->key.build_id_len
+      || memcmp (header->build_id, cache->key.build_id,
+                 header->build_id_len))
+    return FALSE;
+
+  for (guint i = 0; i < INDEX_CACHE_N_SECTIONS; ++i)
+    {
+      guint64 offset = header->sections[i].offset;
+      guint64 count = header->sections[i].count;
+      if (offset % INDEX_CACHE_ALIGN != 0 || offset > length
+          || count > (length - offset) / index_cache_elem_sizes[i])
+        return FALSE;
+    }
+
+  /* The strings must end terminated, so no name runs off the end.  */
+  guint64 nstrings = header->sections[INDEX_CACHE_STRINGS].count;
+  guint64 strings = header->sections[INDEX_CACHE_STRINGS].offset;
+  return nstrings == 0 || contents[strings + nstrings - 1] == '\0';
+}
+
+
+static IndexCache *
+index_cache_new (DwarvishSession *session, const gchar *dir,
+                 const unsigned char *build_id, int build_id_len,
+                 const struct stat *st, gboolean types)
+{
+  IndexCache *cache = g_slice_new0 (IndexCache);
+  memcpy (cache->key.magic, INDEX_CACHE_MAGIC, sizeof cache->key.magic);
+  cache->key.version = INDEX_CACHE_VERSION;
+  cache->key.byte_order = INDEX_CACHE_BYTE_ORDER;
+  cache->key.mtime = st->st_mtime;
+  cache->key.size = st->st_size;
+  cache->key.build_id_len = build_id_len;
+  memcpy (cache->key.build_id, build_id, build_id_len);
+
+  GString *name = g_string_new (NULL);
+  for (int i = 0; i < build_id_len; ++i)
+    g_string_append_printf (name, "%02x", build_id[i]);
+  g_string_append (name, types ? "-types.idx" : "-info.idx");
+  cache->path = g_build_filename (dir, name->str, NULL);
+  g_string_free (name, TRUE);
+
+  cache->map = g_mapped_file_new (cache->path, FALSE, NULL);
+  if (cache->map != NULL
+      && !index_cache_validate (cache, g_mapped_file_get_contents (cache->map),
+                                g_mapped_file_get_length (cache->map)))
+    {
+      g_mapped_file_unref (cache->map);
+      cache->map = NULL;
+    }
+  PROFILE_COUNT (cache->map != NULL ? PROFILE_INDEX_CACHE_HITS
+                 : PROFILE_INDEX_CACHE_MISSES, 1);
+
+  session->index_caches[types] = cache;
+  return cache;
+}
+
+
+/* Look for caches of this session's indexes.  Without a build-id to name
+ * them by, nothing is cached at all.  */
+void
+index_cache_init (DwarvishSession *session)
+{
+  const unsigned char *build_id;
+  GElf_Addr vaddr;
+  int build_id_len = dwfl_module_build_id (session->dwflmod,
+                                           &build_id, &vaddr);
+  if (build_id_len <= 0 || build_id_len > INDEX_CACHE_MAX_BUILD_ID)
+    return;
+
+  struct stat st;
+  const char *file = session->debugfile ?: session->mainfile;
+  if (file == NULL || stat (file, &st) != 0)
+    return;
+
+  gchar *dir = g_build_filename (g_get_user_cache_dir (), "dwarvish", NULL);
+  index_cache_new (session, dir, build_id, build_id_len, &st, FALSE);
+  index_cache_new (session, dir, build_id, build_id_len, &st, TRUE);
+  g_free (dir);
+}
+
+
+/* Get a section of a valid cache, or NULL.  */
+gconstpointer
+index_cache_section (IndexCache *cache, IndexCacheSection section,
+                     gsize *count)
+{
+  if (cache == NULL || cache->map == NULL)
+    return NULL;
+
+  const gchar *contents = g_mapped_file_get_contents (cache->map);
+  const IndexCacheHeader *header = (const IndexCacheHeader *) contents;
+  *count = header->sections[section].count;
+  return contents + header->sections[section].offset;
+}
+
+
+static gboolean
+index_cache_write_padded (FILE *file, gconstpointer data, gsize size)
+{
+  static const char padding[INDEX_CACHE_ALIGN];
+  gsize pad = -size % INDEX_CACHE_ALIGN;
+  return (fwrite (data, 1, size, file) == size
+          && fwrite (padding, 1, pad, file) == pad);
+}
+
+
+/* Save new indexes, replacing whatever cache was there.  This is written
+ * to a temporary file first, so a reader never sees a partial cache.  It's
+ * only touched by one thread at a time, but not necessarily the main one.  */
+gboolean
+index_cache_write (IndexCache *cache, const IndexCacheBlob *blobs)
+{
+  if (cache == NULL)
+    return FALSE;
+
+  gchar *dir = g_path_get_dirname (cache->path);
+  gchar *temp = g_strconcat (cache->path, ".XXXXXX", NULL);
+  int fd = -1;
+  if (g_mkdir_with_parents (dir, 0700) == 0)
+    fd = g_mkstemp (temp);
+  g_free (dir);
+
+  FILE *file = fd >= 0 ? fdopen (fd, "wb") : NULL;
+  if (file == NULL)
+    {
+      if (fd >= 0)
+        {
+          close (fd);
+          unlink (temp);
+        }
+      g_free (temp);
+      return FALSE;
+    }
+
+  IndexCacheHeader header = cache->key;
+  guint64 offset = sizeof header;
+  for (guint i = 0; i < INDEX_CACHE_N_SECTIONS; ++i)
+    {
+      gsize size = blobs[i].count * index_cache_elem_sizes[i];
+      header.sections[i].offset = offset;
+      header.sections[i].count = blobs[i].count;
+      offset += size + (-size % INDEX_CACHE_ALIGN);
+    }
+
+  gboolean ok = index_cache_write_padded (file, &header, sizeof header);
+  for (guint i = 0; ok && i < INDEX_CACHE_N_SECTIONS; ++i)
+    ok = index_cache_write_padded (file, blobs[i].data,
+                                   blobs[i].count * index_cache_elem_sizes[i]);
+
+  ok = (fclose (file) == 0) && ok;
+  if (!ok || rename (temp, cache->path) != 0)
+    {
+      unlink (temp);
+      ok = FALSE;
+    }
+
+  g_free (temp);
+  return ok;
+}
+
+
+static void
+index_cache_destroy (IndexCache *cache)
+{
+  if (cache->map != NULL)
+    g_mapped_file_unref (cache->map);
+  g_free (cache->path);
+  g_slice_free (IndexCache, cache);
+}
+
+
+void
+index_cache_free (DwarvishSession *session)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (session->index_caches); ++i)
+    if (session->index_caches[i] != NULL)
+      index_cache_destroy (session->index_caches[i]);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
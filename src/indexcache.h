@@ -0,0 +1,70 @@
+/*
+ * On-disk index cache interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _INDEXCACHE_H_
+#define _INDEXCACHE_H_
+
+#include <glib.h>
+
+#include "session.h"
+
+
+typedef enum
+{
+  INDEX_CACHE_UNITS = 0,        /* IndexCacheUnit, in file order.  */
+  INDEX_CACHE_NAMES,            /* NameEntry, sorted by name.  */
+  INDEX_CACHE_NAME_FIRSTS,      /* guint32 first entry of each name.  */
+  INDEX_CACHE_STRINGS,          /* char, the names NUL-terminated.  */
+  INDEX_CACHE_PARENTS,          /* IndexCacheParent, sorted by offset.  */
+  INDEX_CACHE_N_SECTIONS
+} IndexCacheSection;
+
+typedef struct _IndexCacheUnit
+{
+  guint64 offset;               /* The unit DIE.  */
+  guint64 type_signature;
+  guint64 type_offset;          /* The type DIE, for type units.  */
+} IndexCacheUnit;
+
+typedef struct _IndexCacheParent
+{
+  guint64 offset;
+  guint64 parent;
+} IndexCacheParent;
+
+typedef struct _IndexCacheBlob
+{
+  gconstpointer data;
+  gsize count;
+} IndexCacheBlob;
+
+typedef struct _IndexCache IndexCache;
+
+
+G_GNUC_INTERNAL
+void index_cache_init (DwarvishSession *session);
+
+G_GNUC_INTERNAL
+gconstpointer index_cache_section (IndexCache *cache,
+                                   IndexCacheSection section,
+                                   gsize *count);
+
+G_GNUC_INTERNAL
+gboolean index_cache_write (IndexCache *cache,
+                            const IndexCacheBlob *blobs);
+
+G_GNUC_INTERNAL
+void index_cache_free (DwarvishSession *session);
+
+
+#endif /* _INDEXCACHE_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,232 @@
+/*
+ * Line table implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "linetable.h"
+#include "profile.h"
+
+
+/* A unit's line program is only decoded when it's first shown, and then
+ * copied out of libdw into a flat array of rows, which libdw has already
+ * sorted by address.  A second array orders the same rows by file and
+ * line, so lookups either way are binary searches.  */
+
+
+static void
+line_table_destroy (gpointer data)
+{
+  LineTable *table = data;
+  g_array_free (table->rows, TRUE);
+  g_array_free (table->by_line, TRUE);
+  g_slice_free (LineTable, table);
+}
+
+
+static gint
+line_table_compare_lines (gconstpointer a, gconstpointer b, gpointer data)
+{
+  const LineRow *rows = data;
+  const LineRow *ra = &rows[*(const guint32 *) a];
+  const LineRow *rb = &rows[*(const guint32 *) b];
+  if (ra->file != rb->file)
+    return ra->file < rb->file ? -1 : 1;
+  if (ra->line != rb->line)
+    return ra->line < rb->line ? -1 : 1;
+  return (ra->addr > rb->addr) - (ra->addr < rb->addr);
+}
+
+
+/* The rows name their files by the same strings as the unit's files, so
+ * those pointers are mapped back to indexes.  */
+static void
+line_table_add_rows (LineTable *table, Dwarf_Lines *lines, size_t nlines)
+{
+  GHashTable *files = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (size_t i = 0; i < table->nfiles; ++i)
+    g_hash_table_insert (files,
+                         (gpointer) dwarf_filesrc (table->files, i, NULL, NULL),
+                         GSIZE_TO_POINTER (i + 1));
+
+  g_array_set_size (table->rows, nlines);
+  for (size_t i = 0; i < nlines; ++i)
+    {
+      Dwarf_Line *line = dwarf_onesrcline (lines, i);
+      LineRow *row = &g_array_index (table->rows, LineRow, i);
+
+      int lineno = 0, column = 0;
+      bool flag;
+      dwarf_lineaddr (line, &row->addr);
+      dwarf_lineno (line, &lineno);
+      dwarf_linecol (line, &column);
+      row->line = lineno;
+      row->column = CLAMP (column, 0, G_MAXUINT16);
+
+      gsize file = GPOINTER_TO_SIZE
+        (g_hash_table_lookup (files, dwarf_linesrc (line, NULL, NULL)));
+      row->file = file > 0 ? file - 1 : G_MAXUINT32;
+
+      row->flags = 0;
+      if (dwarf_linebeginstatement (line, &flag) == 0 && flag)
+        row->flags |= LINE_FLAG_STMT;
+      if (dwarf_lineblock (line, &flag) == 0 && flag)
+        row->flags |= LINE_FLAG_BLOCK;
+      if (dwarf_lineendsequence (line, &flag) == 0 && flag)
+        row->flags |= LINE_FLAG_END_SEQUENCE;
+      if (dwarf_lineprologueend (line, &flag) == 0 && flag)
+        row->flags |= LINE_FLAG_PROLOGUE_END;
+      if (dwarf_lineepiloguebegin (line, &flag) == 0 && flag)
+        row->flags |= LINE_FLAG_EPILOGUE_BEGIN;
+    }
+
+  g_hash_table_destroy (files);
+
+  g_array_set_size (table->by_line, nlines);
+  for (guint32 i = 0; i < nlines; ++i)
+    g_array_index (table->by_line, guint32, i) = i;
+  g_qsort_with_data (table->by_line->data, nlines, sizeof (guint32),
+                     line_table_compare_lines, table->rows->data);
+}
+
+
+static LineTable *
+line_table_new (Dwarf_Die *die)
+{
+  LineTable *table = g_slice_new0 (LineTable);
+  table->rows = g_array_new (FALSE, FALSE, sizeof (LineRow));
+  table->by_line = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  /* A unit without a line program just has an empty table.  */
+  Dwarf_Lines *lines;
+  size_t nlines;
+  if (dwarf_diecu (die, &table->cudie, NULL, NULL) != NULL
+      && dwarf_getsrclines (&table->cudie, &lines, &nlines) == 0
+      && dwarf_getsrcfiles (&table->cudie, &table->files,
+                            &table->nfiles) == 0)
+    line_table_add_rows (table, lines, nlines);
+
+  return table;
+}
+
+
+/* Get the line table of the unit containing a DIE, decoded once per unit.
+ * Units are keyed by their Dwarf_CU, as in cuinfo.c.  */
+LineTable *
+line_table_get (DwarvishSession *session, Dwarf_Die *die)
+{
+  if (session->line_tables == NULL)
+    session->line_tables = g_hash_table_new_full (g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL, line_table_destroy);
+
+  LineTable *table = g_hash_table_lookup (session->line_tables, die->cu);
+  if (table == NULL)
+    {
+      gint64 start = profile_begin ();
+      table = line_table_new (die);
+      g_hash_table_insert (session->line_tables, die->cu, table);
+      profile_end (start, "decode line table");
+    }
+  return table;
+}
+
+
+const char *
+line_table_file (LineTable *table, guint32 file)
+{
+  if (table->files == NULL || file >= table->nfiles)
+    return NULL;
+  return dwarf_filesrc (table->files, file, NULL, NULL);
+}
+
+
+/* Find the first row for an address, skipping the ends of sequences which
+ * happen to stop where it starts, or -1 if no sequence covers it.  */
+gint
+line_table_find_addr (LineTable *table, Dwarf_Addr addr)
+{
+  const LineRow *rows = (const LineRow *) table->rows->data;
+
+  /* The last row at or before the address gives the row's own address.  */
+  guint lo = 0, hi = table->rows->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      if (rows[mid].addr <= addr)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  if (lo == 0)
+    return -1;
+  Dwarf_Addr start = rows[lo - 1].addr;
+
+  /* Then the first row at that address.  */
+  hi = lo - 1;
+  lo = 0;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      if (rows[mid].addr < start)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  for (; lo < table->rows->len && rows[lo].addr == start; ++lo)
+    if (!(rows[lo].flags & LINE_FLAG_END_SEQUENCE))
+      return lo;
+  return -1;
+}
+
+
+/* Find the rows for a file and line, returning how many there are from the
+ * first position in by_line, in order of address.  */
+guint
+line_table_find_line (LineTable *table, guint32 file, guint32 line,
+                      guint *first)
+{
+  const LineRow *rows = (const LineRow *) table->rows->data;
+  const guint32 *by_line = (const guint32 *) table->by_line->data;
+
+  guint lo = 0, hi = table->by_line->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      const LineRow *row = &rows[by_line[mid]];
+      if (row->file < file || (row->file == file && row->line < line))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  *first = lo;
+  guint n = 0;
+  for (guint i = lo; i < table->by_line->len; ++i, ++n)
+    {
+      const LineRow *row = &rows[by_line[i]];
+      if (row->file != file || row->line != line)
+        break;
+    }
+  return n;
+}
+
+
+void
+line_table_free (DwarvishSession *session)
+{
+  if (session->line_tables != NULL)
+    g_hash_table_destroy (session->line_tables);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,73 @@
+/*
+ * Line table interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _LINETABLE_H_
+#define _LINETABLE_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+enum
+{
+  LINE_FLAG_STMT = 1 << 0,
+  LINE_FLAG_BLOCK = 1 << 1,
+  LINE_FLAG_END_SEQUENCE = 1 << 2,
+  LINE_FLAG_PROLOGUE_END = 1 << 3,
+  LINE_FLAG_EPILOGUE_BEGIN = 1 << 4,
+};
+
+typedef struct _LineRow
+{
+  Dwarf_Addr addr;
+  guint32 file;                 /* Index in the unit's files.  */
+  guint32 line;
+  guint16 column;
+  guint16 flags;                /* LINE_FLAG_* */
+} LineRow;
+
+typedef struct _LineTable
+{
+  Dwarf_Die cudie;
+  GArray *rows;                 /* LineRow, sorted by address.  */
+  GArray *by_line;              /* guint32 row index, by file and line.  */
+  Dwarf_Files *files;
+  size_t nfiles;
+} LineTable;
+
+
+G_GNUC_INTERNAL
+LineTable *line_table_get (DwarvishSession *session,
+                           Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+const char *line_table_file (LineTable *table,
+                             guint32 file);
+
+G_GNUC_INTERNAL
+gint line_table_find_addr (LineTable *table,
+                           Dwarf_Addr addr);
+
+G_GNUC_INTERNAL
+guint line_table_find_line (LineTable *table,
+                            guint32 file,
+                            guint32 line,
+                            guint *first);
+
+G_GNUC_INTERNAL
+void line_table_free (DwarvishSession *session);
+
+
+#endif /* _LINETABLE_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
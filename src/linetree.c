@@ -0,0 +1,551 @@
+/*
+ * line-tree view implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <dwarf.h>
+#include "linetree.h"
+#include "addrindex.h"
+#include "dietree.h"
+#include "linetable.h"
+#include "location.h"
+#include "scopevars.h"
+
+
+/* The Lines page shows the line table of the selected DIE's unit.  Its
+ * model is just a view of the unit's LineTable, with the row index as the
+ * only column, and the text is formatted as it's drawn.  So even a huge
+ * table is shown without copying, and its rows for a DIE are found by
+ * binary search in the table's own indexes.  A row's tooltip lists the
+ * variables live at its address.  */
+enum
+{
+  LINE_TREE_COL_ADDRESS = 0,
+  LINE_TREE_COL_FILE,
+  LINE_TREE_COL_LINE,
+  LINE_TREE_COL_COLUMN,
+  LINE_TREE_COL_FLAGS,
+  LINE_TREE_N_VIEW_COLUMNS
+};
+
+/* Tooltips list the variables live at a row's address, up to a point.  */
+#define LINE_TREE_MAX_VARS 40
+
+
+typedef struct _LineTreeModel
+{
+  GObject parent;
+
+  gint stamp;
+  LineTable *table;     /* Owned by the session.  */
+} LineTreeModel;
+
+typedef struct _LineTreeModelClass
+{
+  GObjectClass parent_class;
+} LineTreeModelClass;
+
+static GType line_tree_model_get_type (void);
+#define LINE_TYPE_TREE_MODEL (line_tree_model_get_type ())
+#define LINE_TREE_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), LINE_TYPE_TREE_MODEL, LineTreeModel))
+
+static void line_tree_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (LineTreeModel, line_tree_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                line_tree_model_tree_model_init))
+
+
+/* The view follows the DIE selection, but only reads lines while it's
+ * actually shown, so units are decoded only when their lines are seen.  */
+typedef struct _LineTree
+{
+  GtkTreeView *view;
+  DwarvishSession *session;
+  GtkTreeSelection *die_selection;
+
+  /* The function of each row whose tooltip was shown, or NULL if it has
+   * none, for the table shown.  */
+  LineTable *functions_table;
+  GHashTable *functions;        /* Row index -> Dwarf_Die.  */
+} LineTree;
+
+
+static inline gboolean
+line_tree_model_set_iter (LineTreeModel *model, GtkTreeIter *iter, guint n)
+{
+  if (n >= model->table->rows->len)
+    return FALSE;
+  iter->stamp = model->stamp;
+  iter->user_data = GUINT_TO_POINTER (n);
+  return TRUE;
+}
+
+
+static GtkTreeModelFlags
+line_tree_model_get_flags (G_GNUC_UNUSED GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+
+static gint
+line_tree_model_get_n_columns (G_GNUC_UNUSED GtkTreeModel *tree_model)
+{
+  return 1;
+}
+
+
+static GType
+line_tree_model_get_column_type (G_GNUC_UNUSED GtkTreeModel *tree_model,
+                                 G_GNUC_UNUSED gint index)
+{
+  return G_TYPE_UINT;
+}
+
+
+static gboolean
+line_tree_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                          GtkTreePath *path)
+{
+  LineTreeModel *model = LINE_TREE_MODEL (tree_model);
+  return gtk_tree_path_get_depth (path) == 1
+    && line_tree_model_set_iter (model, iter,
+                                 gtk_tree_path_get_indices (path)[0]);
+}
+
+
+static GtkTreePath *
+line_tree_model_get_path (G_GNUC_UNUSED GtkTreeModel *tree_model,
+                          GtkTreeIter *iter)
+{
+  return gtk_tree_path_new_from_indices (GPOINTER_TO_UINT (iter->user_data),
+                                         -1);
+}
+
+
+static void
+line_tree_model_get_value (G_GNUC_UNUSED GtkTreeModel *tree_model,
+                           GtkTreeIter *iter, G_GNUC_UNUSED gint column,
+                           GValue *value)
+{
+  g_value_init (value, G_TYPE_UINT);
+  g_value_set_uint (value, GPOINTER_TO_UINT (iter->user_data));
+}
+
+
+static gboolean
+line_tree_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  LineTreeModel *model = LINE_TREE_MODEL (tree_model);
+  return line_tree_model_set_iter (model, iter,
+                                   GPOINTER_TO_UINT (iter->user_data) + 1);
+}
+
+
+static gboolean
+line_tree_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                                GtkTreeIter *parent, gint n)
+{
+  LineTreeModel *model = LINE_TREE_MODEL (tree_model);
+  return parent == NULL && n >= 0
+    && line_tree_model_set_iter (model, iter, n);
+}
+
+
+static gboolean
+line_tree_model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                               GtkTreeIter *parent)
+{
+  return line_tree_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+
+static gint
+line_tree_model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  LineTreeModel *model = LINE_TREE_MODEL (tree_model);
+  return iter == NULL ? (gint) model->table->rows->len : 0;
+}
+
+
+static gboolean
+line_tree_model_iter_has_child (G_GNUC_UNUSED GtkTreeModel *tree_model,
+                                G_GNUC_UNUSED GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+
+static gboolean
+line_tree_model_iter_parent (G_GNUC_UNUSED GtkTreeModel *tree_model,
+                             G_GNUC_UNUSED GtkTreeIter *iter,
+                             G_GNUC_UNUSED GtkTreeIter *child)
+{
+  return FALSE;
+}
+
+
+static void
+line_tree_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = line_tree_model_get_flags;
+  iface->get_n_columns = line_tree_model_get_n_columns;
+  iface->get_column_type = line_tree_model_get_column_type;
+  iface->get_iter = line_tree_model_get_iter;
+  iface->get_path = line_tree_model_get_path;
+  iface->get_value = line_tree_model_get_value;
+  iface->iter_next = line_tree_model_iter_next;
+  iface->iter_children = line_tree_model_iter_children;
+  iface->iter_has_child = line_tree_model_iter_has_child;
+  iface->iter_n_children = line_tree_model_iter_n_children;
+  iface->iter_nth_child = line_tree_model_iter_nth_child;
+  iface->iter_parent = line_tree_model_iter_parent;
+}
+
+
+static void
+line_tree_model_init (LineTreeModel *model)
+{
+  model->stamp = g_random_int ();
+}
+
+
+static void
+line_tree_model_class_init (G_GNUC_UNUSED LineTreeModelClass *klass)
+{
+}
+
+
+static LineTreeModel *
+line_tree_model_new (LineTable *table)
+{
+  LineTreeModel *model = g_object_new (LINE_TYPE_TREE_MODEL, NULL);
+  model->table = table;
+  return model;
+}
+
+
+static void
+line_tree_cell_data (G_GNUC_UNUSED GtkTreeViewColumn *col,
+                     GtkCellRenderer *renderer, GtkTreeModel *model,
+                     GtkTreeIter *iter, gpointer data)
+{
+  LineTable *table = LINE_TREE_MODEL (model)->table;
+  const LineRow *row = &g_array_index (table->rows, LineRow,
+                                       GPOINTER_TO_UINT (iter->user_data));
+
+  char text[80] = "";
+  switch (GPOINTER_TO_INT (data))
+    {
+    case LINE_TREE_COL_ADDRESS:
+      g_snprintf (text, sizeof text, "%#" G_GINT64_MODIFIER "x", row->addr);
+      break;
+
+    case LINE_TREE_COL_FILE:
+      g_object_set (renderer, "text", line_table_file (table, row->file),
+                    NULL);
+      return;
+
+    case LINE_TREE_COL_LINE:
+      g_snprintf (text, sizeof text, "%u", row->line);
+      break;
+
+    case LINE_TREE_COL_COLUMN:
+      if (row->column != 0)
+        g_snprintf (text, sizeof text, "%u", row->column);
+      break;
+
+    case LINE_TREE_COL_FLAGS:
+      g_snprintf (text, sizeof text, "%s%s%s%s%s",
+                  row->flags & LINE_FLAG_STMT ? " stmt" : "",
+                  row->flags & LINE_FLAG_BLOCK ? " block" : "",
+                  row->flags & LINE_FLAG_PROLOGUE_END ? " prologue_end" : "",
+                  row->flags & LINE_FLAG_EPILOGUE_BEGIN
+                  ? " epilogue_begin" : "",
+                  row->flags & LINE_FLAG_END_SEQUENCE ? " end_sequence" : "");
+      g_object_set (renderer, "text", text[0] ? text + 1 : text, NULL);
+      return;
+    }
+
+  g_object_set (renderer, "text", text, NULL);
+}
+
+
+static void
+line_tree_render_column (GtkTreeView *view, gint column)
+{
+  GtkTreeViewColumn *col = gtk_tree_view_get_column (view, column);
+  GtkCellRenderer *renderer = gtk_cell_renderer_text_new ();
+  g_object_set (renderer, "font", "monospace 9", NULL);
+  if (column == LINE_TREE_COL_FILE)
+    {
+      g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_START, NULL);
+      gtk_tree_view_column_set_expand (col, TRUE);
+    }
+
+  gtk_tree_view_column_pack_start (col, renderer, TRUE);
+  gtk_tree_view_column_set_cell_data_func (col, renderer,
+                                           line_tree_cell_data,
+                                           GINT_TO_POINTER (column), NULL);
+}
+
+
+/* Select the rows for a DIE: those within its addresses if it has code,
+ * else those for its declared line.  */
+static void
+line_tree_select_die (LineTree *tree, LineTable *table, Dwarf_Die *die)
+{
+  GtkTreeSelection *selection = gtk_tree_view_get_selection (tree->view);
+  gtk_tree_selection_unselect_all (selection);
+
+  gint first = -1;
+  Dwarf_Addr low, high;
+  Dwarf_Attribute attr;
+  Dwarf_Word file, line;
+  if (dwarf_lowpc (die, &low) == 0 || dwarf_entrypc (die, &low) == 0)
+    {
+      first = line_table_find_addr (table, low);
+      if (first < 0)
+        return;
+
+      guint last = first;
+      if (dwarf_highpc (die, &high) == 0)
+        while (last + 1 < table->rows->len
+               && g_array_index (table->rows, LineRow, last + 1).addr < high)
+          ++last;
+
+      GtkTreePath *start = gtk_tree_path_new_from_indices (first, -1);
+      GtkTreePath *end = gtk_tree_path_new_from_indices (last, -1);
+      gtk_tree_selection_select_range (selection, start, end);
+      gtk_tree_path_free (start);
+      gtk_tree_path_free (end);
+    }
+  else if (dwarf_attr_integrate (die, DW_AT_decl_file, &attr) != NULL
+           && dwarf_formudata (&attr, &file) == 0
+           && dwarf_attr_integrate (die, DW_AT_decl_line, &attr) != NULL
+           && dwarf_formudata (&attr, &line) == 0)
+    {
+      guint pos;
+      guint n = line_table_find_line (table, file, line, &pos);
+      for (guint i = 0; i < n; ++i)
+        {
+          guint32 row = g_array_index (table->by_line, guint32, pos + i);
+          GtkTreePath *path = gtk_tree_path_new_from_indices (row, -1);
+          gtk_tree_selection_select_path (selection, path);
+          gtk_tree_path_free (path);
+          first = (first < 0) ? (gint) row : MIN (first, (gint) row);
+        }
+    }
+
+  if (first >= 0)
+    {
+      GtkTreePath *path = gtk_tree_path_new_from_indices (first, -1);
+      gtk_tree_view_scroll_to_cell (tree->view, path, NULL, TRUE, 0.0, 0.0);
+      gtk_tree_path_free (path);
+    }
+}
+
+
+static void
+line_tree_refresh (LineTree *tree)
+{
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  Dwarf_Die die;
+  if (tree->die_selection == NULL
+      || !gtk_widget_get_mapped (GTK_WIDGET (tree->view))
+      || !gtk_tree_selection_get_selected (tree->die_selection, &model, &iter)
+      || !die_tree_get_die (model, &iter, &die))
+    return;
+
+  /* Switch to the unit's table, decoding it if it's the first time.  */
+  LineTable *table = line_table_get (tree->session, &die);
+  GtkTreeModel *current = gtk_tree_view_get_model (tree->view);
+  if (current == NULL || LINE_TREE_MODEL (current)->table != table)
+    {
+      LineTreeModel *lines = line_tree_model_new (table);
+      gtk_tree_view_set_model (tree->view, GTK_TREE_MODEL (lines));
+      g_object_unref (lines); /* The view keeps its own reference.  */
+    }
+
+  line_tree_select_die (tree, table, &die);
+}
+
+
+static void
+line_tree_function_free (gpointer data)
+{
+  if (data != NULL)
+    g_slice_free (Dwarf_Die, data);
+}
+
+
+/* Find the function with a row's address, once per row.  It's normally in
+ * the address index's table of the unit's functions, and only while that's
+ * still being built, or for units it doesn't reach, such as split units,
+ * are the unit's scopes searched instead.  */
+static gboolean
+line_tree_row_function (LineTree *tree, LineTable *table, guint index,
+                        Dwarf_Die *function)
+{
+  if (tree->functions == NULL)
+    tree->functions = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL, line_tree_function_free);
+  if (tree->functions_table != table)
+    {
+      g_hash_table_remove_all (tree->functions);
+      tree->functions_table = table;
+    }
+
+  Dwarf_Die *found;
+  if (!g_hash_table_lookup_extended (tree->functions,
+                                     GUINT_TO_POINTER (index),
+                                     NULL, (gpointer *) &found))
+    {
+      Dwarf_Addr pc = g_array_index (table->rows, LineRow, index).addr;
+      Dwarf_Die die;
+      if ((addr_index_function (addr_index_get (tree->session), pc, &die)
+           && die.cu == table->cudie.cu)
+          || scope_vars_function (&table->cudie, pc, &die))
+        found = g_slice_dup (Dwarf_Die, &die);
+      else
+        found = NULL;
+      g_hash_table_insert (tree->functions, GUINT_TO_POINTER (index), found);
+    }
+
+  if (found == NULL)
+    return FALSE;
+  *function = *found;
+  return TRUE;
+}
+
+
+/* List the variables live at a row's address, with where each one is.  */
+static gboolean
+signal_line_tree_query_tooltip (GtkWidget *widget, gint x, gint y,
+                                gboolean keyboard_mode, GtkTooltip *tooltip,
+                                gpointer user_data)
+{
+  LineTree *tree = user_data;
+  GtkTreeView *view = GTK_TREE_VIEW (widget);
+
+  GtkTreeModel *model;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  if (!gtk_tree_view_get_tooltip_context (view, &x, &y, keyboard_mode,
+                                          &model, &path, &iter))
+    return FALSE;
+
+  LineTable *table = LINE_TREE_MODEL (model)->table;
+  guint index = GPOINTER_TO_UINT (iter.user_data);
+  const LineRow *row = &g_array_index (table->rows, LineRow, index);
+  Dwarf_Die function;
+  if ((row->flags & LINE_FLAG_END_SEQUENCE)
+      || !line_tree_row_function (tree, table, index, &function))
+    {
+      gtk_tree_path_free (path);
+      return FALSE;
+    }
+
+  GArray *vars = g_array_new (FALSE, FALSE, sizeof (Dwarf_Die));
+  scope_vars_live (tree->session, &function, row->addr, vars);
+
+  GString *text = g_string_new (NULL);
+  g_string_printf (text, "Live in %s at %#" G_GINT64_MODIFIER "x:",
+                   dwarf_diename (&function) ?: "<anonymous>", row->addr);
+  for (guint i = 0; i < vars->len && i < LINE_TREE_MAX_VARS; ++i)
+    {
+      Dwarf_Die *var = &g_array_index (vars, Dwarf_Die, i);
+      Dwarf_Attribute attr;
+      const char *name = dwarf_formstring (dwarf_attr_integrate
+                                           (var, DW_AT_name, &attr));
+      gchar *location = location_at_string (var, row->addr);
+      g_string_append_printf (text, "\n  %s%s: %s",
+                              dwarf_tag (var) == DW_TAG_formal_parameter
+                              ? "parameter " : "", name ?: "<anonymous>",
+                              location);
+      g_free (location);
+    }
+  if (vars->len > LINE_TREE_MAX_VARS)
+    g_string_append_printf (text, "\n  (%u more)",
+                            vars->len - LINE_TREE_MAX_VARS);
+  else if (vars->len == 0)
+    g_string_append (text, "\n  (none)");
+  g_array_free (vars, TRUE);
+
+  gtk_tooltip_set_text (tooltip, text->str);
+  gtk_tree_view_set_tooltip_row (view, tooltip, path);
+  g_string_free (text, TRUE);
+  gtk_tree_path_free (path);
+  return TRUE;
+}
+
+
+G_MODULE_EXPORT void
+signal_line_tree_die_selection_changed (GtkTreeSelection *selection,
+                                        gpointer user_data)
+{
+  LineTree *tree = g_object_get_data (G_OBJECT (user_data), "LineTree");
+  if (tree == NULL)
+    return;
+
+  if (tree->die_selection == NULL)
+    tree->die_selection = g_object_ref (selection);
+  line_tree_refresh (tree);
+}
+
+
+/* Catch up with the DIE selection once the page is shown.  */
+static void
+signal_line_tree_map (G_GNUC_UNUSED GtkWidget *widget, gpointer user_data)
+{
+  line_tree_refresh (user_data);
+}
+
+
+static void
+line_tree_free (gpointer data)
+{
+  LineTree *tree = data;
+  if (tree->die_selection != NULL)
+    g_object_unref (tree->die_selection);
+  if (tree->functions != NULL)
+    g_hash_table_destroy (tree->functions);
+  g_slice_free (LineTree, tree);
+}
+
+
+gboolean
+line_tree_view_render (GtkTreeView *view, DwarvishSession *session)
+{
+  LineTree *tree = g_slice_new0 (LineTree);
+  tree->view = view;
+  tree->session = session;
+  g_object_set_data_full (G_OBJECT (view), "LineTree", tree, line_tree_free);
+
+  for (gint i = 0; i < LINE_TREE_N_VIEW_COLUMNS; ++i)
+    line_tree_render_column (view, i);
+  gtk_tree_selection_set_mode (gtk_tree_view_get_selection (view),
+                               GTK_SELECTION_MULTIPLE);
+
+  g_signal_connect_after (view, "map",
+                          G_CALLBACK (signal_line_tree_map), tree);
+  g_signal_connect (view, "query-tooltip",
+                    G_CALLBACK (signal_line_tree_query_tooltip), tree);
+  gtk_widget_set_has_tooltip (GTK_WIDGET (view), TRUE);
+  return TRUE;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
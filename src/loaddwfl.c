@@ -14,6 +14,7 @@
 
 #include <glib.h>
 #include <string.h>
+#include <sys/utsname.h>
 #include <elfutils/libdwelf.h>
 
 #include "loaddwfl.h"
@@ -45,29 +46,119 @@ load_elf_dwfl (const char *file)
 }
 
 
-static const char *search_module;
+/* Modules are matched by name as the kernel and libdwfl know them: the
+ * file's basename without ".ko" and any compression suffix, with '-' and
+ * ',' as '_'.  */
+static gchar *
+kernel_module_name (const char *path)
+{
+  gchar *name = g_path_get_basename (path);
+
+  gchar *suffix = strstr (name, ".ko");
+  if (suffix != NULL && (suffix[3] == '\0' || suffix[3] == '.'))
+    *suffix = '\0';
+  g_strdelimit (name, "-,", '_');
+  return name;
+}
+
+
+/* The modules still to be reported, as a set of names, and maybe a
+ * pattern for any number more.  Each search is on the stack of the thread
+ * making it, so any number can run at once.  */
+typedef struct _KernelSearch
+{
+  GHashTable *wanted;
+  GPatternSpec *pattern;
+} KernelSearch;
+
+static GPrivate kernel_search_key = G_PRIVATE_INIT (NULL);
+
+static gboolean
+kernel_search_match (KernelSearch *search, const char *module)
+{
+  return (g_hash_table_remove (search->wanted, module)
+          || (search->pattern != NULL
+              && g_pattern_match_string (search->pattern, module)));
+}
 
 static int
-module_predicate (const char *module, G_GNUC_UNUSED const char *path)
+kernel_search_predicate (const char *module, G_GNUC_UNUSED const char *path)
 {
-  if (search_module == NULL)
+  KernelSearch *search = g_private_get (&kernel_search_key);
+  if (kernel_search_match (search, module))
+    return 1;
+  if (search->pattern == NULL && g_hash_table_size (search->wanted) == 0)
     return -1;
+  return 0;
+}
 
-  if (g_strcmp0 (search_module, module) == 0)
+
+/* Report the wanted modules found in modules.dep, which lists every module
+ * installed for the release, so the module tree needn't be walked.  The
+ * paths are relative to the modules directory.  Returns whether there was
+ * a modules.dep to read.  */
+static gboolean
+kernel_report_modules_dep (Dwfl *dwfl, const char *kernel,
+                           KernelSearch *search)
+{
+  gchar *modulesdir;
+  if (kernel != NULL && kernel[0] == '/')
+    modulesdir = g_strdup (kernel);
+  else
     {
-      search_module = NULL;
-      return 1;
+      struct utsname uts;
+      if (kernel == NULL && uname (&uts) != 0)
+        return FALSE;
+      modulesdir = g_build_filename ("/lib/modules", kernel ?: uts.release,
+                                     NULL);
     }
 
-  return 0;
+  gchar *depfile = g_build_filename (modulesdir, "modules.dep", NULL);
+  gchar *contents = NULL;
+  gboolean found = g_file_get_contents (depfile, &contents, NULL, NULL);
+  if (found)
+    for (gchar *line = contents, *next;
+         line != NULL && (search->pattern != NULL
+                          || g_hash_table_size (search->wanted) > 0);
+         line = next)
+      {
+        next = strchr (line, '\n');
+        if (next != NULL)
+          *next++ = '\0';
+
+        gchar *colon = strchr (line, ':');
+        if (colon == NULL)
+          continue;
+        *colon = '\0';
+
+        gchar *name = kernel_module_name (line);
+        if (kernel_search_match (search, name))
+          {
+            gchar *path = g_path_is_absolute (line) ? g_strdup (line)
+              : g_build_filename (modulesdir, line, NULL);
+            dwfl_report_offline (dwfl, name, path, -1);
+            g_free (path);
+          }
+        g_free (name);
+      }
+
+  g_free (contents);
+  g_free (depfile);
+  g_free (modulesdir);
+  return found;
 }
 
 
+/* Report the named modules of a kernel release, or its vmlinux for the
+ * name "kernel", failing unless every one is found.  Any modules matching
+ * the glob pattern are reported too, if one is given.  Modules are looked
+ * up in modules.dep, and libdwfl only walks the module tree for those that
+ * aren't listed there.  Once everything is found, that walk is cut short,
+ * so a lone vmlinux only costs the kernel's own lookup.  */
 Dwfl *
-load_kernel_dwfl (const char *kernel, const char *module)
+load_kernel_dwfl (const char *kernel, const char *const *modules,
+                  const char *pattern)
 {
-  (void)kernel;
-  (void)module;
   static const Dwfl_Callbacks kernel_callbacks =
     {
       dwfl_linux_kernel_find_elf,
@@ -76,14 +167,53 @@ load_kernel_dwfl (const char *kernel, const char *module)
       NULL
     };
 
+  KernelSearch search;
+  search.wanted = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, NULL);
+  for (guint i = 0; modules[i] != NULL; ++i)
+    {
+      gchar *name = kernel_module_name (modules[i]);
+      g_hash_table_insert (search.wanted, name, name);
+    }
+
+  search.pattern = NULL;
+  if (pattern != NULL)
+    {
+      gchar *name = g_strdup (pattern);
+      g_strdelimit (name, "-,", '_');
+      search.pattern = g_pattern_spec_new (name);
+      g_free (name);
+    }
+
   Dwfl *dwfl = dwfl_begin (&kernel_callbacks);
   dwfl_report_begin (dwfl);
 
-  search_module = module ?: "kernel";
-  dwfl_linux_kernel_report_offline (dwfl, kernel, module_predicate);
+  /* The kernel isn't in modules.dep, so it always takes the long way.  */
+  gboolean want_kernel = g_hash_table_remove (search.wanted, "kernel");
+  if (kernel_report_modules_dep (dwfl, kernel, &search)
+      && search.pattern != NULL)
+    {
+      g_pattern_spec_free (search.pattern);
+      search.pattern = NULL;
+    }
+  if (want_kernel)
+    g_hash_table_insert (search.wanted, g_strdup ("kernel"), NULL);
+
+  if (search.pattern != NULL || g_hash_table_size (search.wanted) > 0)
+    {
+      gpointer outer = g_private_get (&kernel_search_key);
+      g_private_set (&kernel_search_key, &search);
+      dwfl_linux_kernel_report_offline (dwfl, kernel,
+                                        kernel_search_predicate);
+      g_private_set (&kernel_search_key, outer);
+    }
 
   dwfl_report_end (dwfl, NULL, NULL);
-  if (search_module == NULL)
+  gboolean found = (g_hash_table_size (search.wanted) == 0);
+  g_hash_table_destroy (search.wanted);
+  if (search.pattern != NULL)
+    g_pattern_spec_free (search.pattern);
+  if (found)
     return dwfl;
 
   dwfl_end (dwfl);
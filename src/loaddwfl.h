@@ -18,7 +18,9 @@ G_GNUC_INTERNAL
 Dwfl *load_elf_dwfl (const char *file);
 
 G_GNUC_INTERNAL
-Dwfl *load_kernel_dwfl (const char *kernel, const char *module);
+Dwfl *load_kernel_dwfl (const char *kernel,
+                        const char *const *modules,
+                        const char *pattern);
 
 G_GNUC_INTERNAL
 Dwfl_Module *get_first_module (Dwfl *dwfl);
@@ -0,0 +1,226 @@
+/*
+ * Location description implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <dwarf.h>
+#include "location.h"
+#include "dwstring.h"
+
+
+/* Whether an attribute's block or section offset is a location, rather
+ * than some other kind of data.  */
+gboolean
+location_attr_is_location (Dwarf_Attribute *attr)
+{
+  switch (dwarf_whatattr (attr))
+    {
+    case DW_AT_location:
+    case DW_AT_string_length:
+    case DW_AT_return_addr:
+    case DW_AT_data_member_location:
+    case DW_AT_frame_base:
+    case DW_AT_segment:
+    case DW_AT_static_link:
+    case DW_AT_use_location:
+    case DW_AT_vtable_elem_location:
+    case DW_AT_GNU_call_site_value:
+    case DW_AT_GNU_call_site_data_value:
+    case DW_AT_GNU_call_site_target:
+    case DW_AT_GNU_call_site_target_clobbered:
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+
+/* Print one operation with its operands, as libdw decoded them.  */
+static void
+location_append_op (GString *out, const Dwarf_Op *op)
+{
+  g_string_append (out, DW_OP__name (op->atom));
+
+  switch (op->atom)
+    {
+    case DW_OP_addr:
+      g_string_append_printf (out, " %#" G_GINT64_MODIFIER "x", op->number);
+      break;
+
+    case DW_OP_const1s:
+    case DW_OP_const2s:
+    case DW_OP_const4s:
+    case DW_OP_const8s:
+    case DW_OP_consts:
+    case DW_OP_fbreg:
+    case DW_OP_skip:
+    case DW_OP_bra:
+    case DW_OP_breg0 ... DW_OP_breg31:
+      g_string_append_printf (out, " %" G_GINT64_FORMAT,
+                              (gint64) op->number);
+      break;
+
+    case DW_OP_const1u:
+    case DW_OP_const2u:
+    case DW_OP_const4u:
+    case DW_OP_const8u:
+    case DW_OP_constu:
+    case DW_OP_pick:
+    case DW_OP_plus_uconst:
+    case DW_OP_regx:
+    case DW_OP_piece:
+    case DW_OP_deref_size:
+    case DW_OP_xderef_size:
+      g_string_append_printf (out, " %" G_GUINT64_FORMAT, op->number);
+      break;
+
+    case DW_OP_bregx:
+      g_string_append_printf (out, " %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT,
+                              op->number, (gint64) op->number2);
+      break;
+
+    case DW_OP_bit_piece:
+      g_string_append_printf (out, " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT,
+                              op->number, op->number2);
+      break;
+
+    case DW_OP_call2:
+    case DW_OP_call4:
+    case DW_OP_call_ref:
+    case DW_OP_GNU_parameter_ref:
+    case DW_OP_GNU_convert:
+    case DW_OP_GNU_reinterpret:
+    case DW_OP_GNU_const_type:
+      g_string_append_printf (out, " [%" G_GINT64_MODIFIER "x]", op->number);
+      break;
+
+    case DW_OP_GNU_implicit_pointer:
+      g_string_append_printf (out, " [%" G_GINT64_MODIFIER "x] %"
+                              G_GINT64_FORMAT, op->number, (gint64) op->number2);
+      break;
+
+    case DW_OP_GNU_regval_type:
+    case DW_OP_GNU_deref_type:
+      g_string_append_printf (out, " %" G_GUINT64_FORMAT " [%"
+                              G_GINT64_MODIFIER "x]", op->number, op->number2);
+      break;
+
+    case DW_OP_implicit_value:
+    case DW_OP_GNU_entry_value:
+      /* These carry blocks, which are only summarized.  */
+      g_string_append_printf (out, " <%" G_GUINT64_FORMAT " bytes>",
+                              op->number);
+      break;
+
+    default:
+      break;
+    }
+}
+
+
+void
+location_append_ops (GString *out, const Dwarf_Op *ops, size_t nops)
+{
+  for (size_t i = 0; i < nops; ++i)
+    {
+      if (i > 0)
+        g_string_append_c (out, ' ');
+      location_append_op (out, &ops[i]);
+    }
+}
+
+
+/* Print a location expression, or each entry of a location list with its
+ * addresses, separated so it still fits one row.  A list's own offset is
+ * kept in front, as section offsets were shown before.  */
+char *
+location_list_string (Dwarf_Attribute *attr)
+{
+  GString *out = g_string_new (NULL);
+  Dwarf_Word offset;
+  if (dwarf_whatform (attr) != DW_FORM_exprloc
+      && dwarf_formudata (attr, &offset) == 0)
+    g_string_append_printf (out, "[%" G_GINT64_MODIFIER "x]", offset);
+
+  Dwarf_Addr base, start, end;
+  Dwarf_Op *ops;
+  size_t nops;
+  ptrdiff_t next = 0;
+  guint n = 0;
+  while ((next = dwarf_getlocations (attr, next, &base, &start, &end,
+                                     &ops, &nops)) > 0)
+    {
+      if (out->len > 0)
+        g_string_append (out, n > 0 ? "; " : " ");
+      ++n;
+
+      /* A single expression holds everywhere.  */
+      if (start != 0 || end != (Dwarf_Addr) -1)
+        g_string_append_printf (out, "[%#" G_GINT64_MODIFIER "x, %#"
+                                G_GINT64_MODIFIER "x) ", start, end);
+      location_append_ops (out, ops, nops);
+    }
+
+  if (next < 0 && n == 0)
+    {
+      g_string_free (out, TRUE);
+      return NULL;
+    }
+  return g_string_free (out, FALSE);
+}
+
+
+/* Print the address ranges of a DIE, after the offset of its list.  */
+char *
+location_ranges_string (Dwarf_Die *die)
+{
+  GString *out = g_string_new (NULL);
+  Dwarf_Attribute attr;
+  Dwarf_Word offset;
+  if (dwarf_attr (die, DW_AT_ranges, &attr) != NULL
+      && dwarf_formudata (&attr, &offset) == 0)
+    g_string_append_printf (out, "[%" G_GINT64_MODIFIER "x]", offset);
+
+  Dwarf_Addr base, start, end;
+  ptrdiff_t next = 0;
+  guint n = 0;
+  while ((next = dwarf_ranges (die, next, &base, &start, &end)) > 0)
+    g_string_append_printf (out, "%s[%#" G_GINT64_MODIFIER "x, %#"
+                            G_GINT64_MODIFIER "x)", n++ > 0 ? "; " : " ",
+                            start, end);
+
+  return g_string_free (out, FALSE);
+}
+
+
+/* Print where a variable is at an address, for listing what's live.  */
+char *
+location_at_string (Dwarf_Die *die, Dwarf_Addr pc)
+{
+  Dwarf_Attribute attr;
+  if (dwarf_attr (die, DW_AT_location, &attr) == NULL)
+    return g_strdup (dwarf_attr (die, DW_AT_const_value, &attr) != NULL
+                     ? "constant" : "optimized out");
+
+  Dwarf_Op *ops;
+  size_t nops;
+  if (dwarf_getlocation_addr (&attr, pc, &ops, &nops, 1) <= 0)
+    return g_strdup ("optimized out");
+
+  GString *out = g_string_new (NULL);
+  location_append_ops (out, ops, nops);
+  return g_string_free (out, FALSE);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
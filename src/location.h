@@ -0,0 +1,40 @@
+/*
+ * Location description interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _LOCATION_H_
+#define _LOCATION_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+
+G_GNUC_INTERNAL
+gboolean location_attr_is_location (Dwarf_Attribute *attr);
+
+G_GNUC_INTERNAL
+void location_append_ops (GString *out,
+                          const Dwarf_Op *ops,
+                          size_t nops);
+
+G_GNUC_INTERNAL
+char *location_list_string (Dwarf_Attribute *attr);
+
+G_GNUC_INTERNAL
+char *location_ranges_string (Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+char *location_at_string (Dwarf_Die *die,
+                          Dwarf_Addr pc);
+
+
+#endif /* _LOCATION_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -8,12 +8,11 @@
  * version 3 of the License, or (at your option) any later version.
  */
 
-#define _GNU_SOURCE 1
-
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -21,8 +20,13 @@
 
 #include "session.h"
 #include "attrtree.h"
+#include "diesearch.h"
 #include "dietree.h"
-#include "loaddwfl.h"
+#include "dump.h"
+#include "linetree.h"
+#include "moduletree.h"
+#include "nameindex.h"
+#include "profile.h"
 
 
 /* Like the gtk_builder_new_from_resource in 3.10, but this project's
@@ -38,18 +42,33 @@ load_gtk_builder (const gchar *resource_path)
 }
 
 
+static GtkTreeView *open_die_view (DwarvishSession *session, gboolean types,
+                                   gpointer user_data);
+
 static GtkWidget *
-create_die_widget (DwarvishSession *session, gboolean types)
+create_die_widget (DwarvishSession *session, gboolean types,
+                   GtkSpinner *spinner, GtkNotebook *notebook)
 {
   GtkBuilder *builder = load_gtk_builder ("/dwarvish/die.ui");
 
   GtkWidget *widget = GTK_WIDGET (gtk_builder_get_object (builder, "widget"));
   GtkTreeView *dieview = GTK_TREE_VIEW (gtk_builder_get_object (builder, "dietreeview"));
   GtkTreeView *attrview = GTK_TREE_VIEW (gtk_builder_get_object (builder, "attrtreeview"));
+  GtkTreeView *lineview = GTK_TREE_VIEW (gtk_builder_get_object (builder, "linetreeview"));
+  GtkEntry *search = GTK_ENTRY (gtk_builder_get_object (builder, "diesearch"));
+  GtkEntry *address = GTK_ENTRY (gtk_builder_get_object (builder, "addrsearch"));
 
-  if (die_tree_view_render (dieview, session, types)
-      && attr_tree_view_render (attrview, session))
+  if (die_tree_view_render (dieview, session, types, spinner)
+      && attr_tree_view_render (attrview, session)
+      && line_tree_view_render (lineview, session))
     {
+      die_search_entry_setup (search, dieview, session, types);
+      /* Only .debug_info has code addresses.  */
+      gtk_widget_set_visible (GTK_WIDGET (address), !types);
+      if (!types)
+        die_address_entry_setup (address, dieview, session);
+      die_tree_view_set_open_func (dieview, open_die_view, notebook);
+      g_object_set_data (G_OBJECT (widget), "DieTreeView", dieview);
       g_object_ref (widget);
       gtk_builder_connect_signals (builder, NULL);
     }
@@ -87,6 +106,236 @@ set_builder_label (GtkBuilder *builder, const char *name, const char *value)
 }
 
 
+/* Notebook tabs have a spinner to show while their units are loading.  */
+static GtkWidget *
+create_tab_label (const gchar *text, GtkSpinner **spinner)
+{
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 4);
+  GtkWidget *label = gtk_label_new (text);
+  GtkWidget *spin = gtk_spinner_new ();
+  gtk_box_pack_start (GTK_BOX (box), label, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (box), spin, FALSE, FALSE, 0);
+  gtk_widget_set_no_show_all (spin, TRUE);
+  gtk_widget_show (label);
+  gtk_widget_show (box);
+  *spinner = GTK_SPINNER (spin);
+  return box;
+}
+
+
+/* Notebook pages start out as an empty box, and their die widget is only
+ * created when the page is first shown, so startup only pays for the first
+ * page.  Once a page has been hidden for a while, its widget and models
+ * are dropped again if memory is short, to be created anew when next
+ * shown.  */
+#define DIE_PAGE_RELEASE_S 300
+#define DIE_PAGE_CHECK_S 60
+#define DIE_PAGE_LOW_MEMORY_PERCENT 10
+
+typedef struct _DiePage
+{
+  DwarvishSession *session;
+  gboolean types;
+  GtkSpinner *spinner;
+  GtkWidget *box;       /* The notebook page, which owns this.  */
+  GtkWidget *widget;    /* The die widget, while there is one.  */
+  gint64 hidden_since;  /* Monotonic time, or 0 while shown.  */
+} DiePage;
+
+
+static void
+die_page_show (DiePage *page)
+{
+  page->hidden_since = 0;
+  if (page->widget != NULL)
+    return;
+
+  gint64 start = profile_begin ();
+  GtkWidget *notebook = gtk_widget_get_parent (page->box);
+  page->widget = create_die_widget (page->session, page->types,
+                                    page->spinner, GTK_NOTEBOOK (notebook));
+  profile_end (start, page->types ? "create types view" : "create info view");
+  if (page->widget != NULL)
+    {
+      gtk_box_pack_start (GTK_BOX (page->box), page->widget, TRUE, TRUE, 0);
+      gtk_widget_show_all (page->widget);
+      g_object_unref (page->widget);
+    }
+}
+
+
+static void
+die_page_release (DiePage *page)
+{
+  gtk_widget_destroy (page->widget);
+  page->widget = NULL;
+
+  /* The units may not have finished loading.  */
+  gtk_spinner_stop (page->spinner);
+  gtk_widget_hide (GTK_WIDGET (page->spinner));
+}
+
+
+static void
+signal_notebook_switch_page (GtkNotebook *notebook, GtkWidget *shown,
+                             G_GNUC_UNUSED guint page_num,
+                             G_GNUC_UNUSED gpointer user_data)
+{
+  gint n_pages = gtk_notebook_get_n_pages (notebook);
+  for (gint i = 0; i < n_pages; ++i)
+    {
+      GtkWidget *box = gtk_notebook_get_nth_page (notebook, i);
+      DiePage *page = g_object_get_data (G_OBJECT (box), "DiePage");
+      if (page == NULL)
+        continue;
+      if (box == shown)
+        die_page_show (page);
+      else if (page->hidden_since == 0)
+        page->hidden_since = g_get_monotonic_time ();
+    }
+}
+
+
+/* Whether less than a few percent of memory is available, as far as the
+ * kernel can say.  Without MemAvailable, nothing is ever released.  */
+static gboolean
+memory_is_low (void)
+{
+  FILE *meminfo = fopen ("/proc/meminfo", "r");
+  if (meminfo == NULL)
+    return FALSE;
+
+  guint64 total = 0, available = 0;
+  char line[128];
+  while (fgets (line, sizeof line, meminfo) != NULL)
+    if (sscanf (line, "MemTotal: %" G_GUINT64_FORMAT, &total) != 1)
+      sscanf (line, "MemAvailable: %" G_GUINT64_FORMAT, &available);
+  fclose (meminfo);
+
+  return (total > 0 && available > 0
+          && available < total / 100 * DIE_PAGE_LOW_MEMORY_PERCENT);
+}
+
+
+static gboolean
+die_pages_check (gpointer data)
+{
+  GtkNotebook *notebook = data;
+  gint64 now = g_get_monotonic_time ();
+  gboolean low = FALSE, checked = FALSE;
+
+  gint n_pages = gtk_notebook_get_n_pages (notebook);
+  for (gint i = 0; i < n_pages; ++i)
+    {
+      GtkWidget *box = gtk_notebook_get_nth_page (notebook, i);
+      DiePage *page = g_object_get_data (G_OBJECT (box), "DiePage");
+      if (page == NULL || page->widget == NULL || page->hidden_since == 0
+          || now - page->hidden_since < DIE_PAGE_RELEASE_S * G_USEC_PER_SEC)
+        continue;
+
+      /* Only look at memory if there's something to release.  */
+      if (!checked)
+        {
+          low = memory_is_low ();
+          checked = TRUE;
+        }
+      if (low)
+        die_page_release (page);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+static void
+die_pages_check_remove (gpointer data)
+{
+  g_source_remove (GPOINTER_TO_UINT (data));
+}
+
+
+static void
+die_page_free (gpointer data)
+{
+  DiePage *page = data;
+  g_object_unref (page->spinner);
+  g_slice_free (DiePage, page);
+}
+
+
+/* Add an empty page if there are any units to show in it.  */
+static GtkWidget *
+append_die_page (GtkNotebook *notebook, DwarvishSession *session,
+                 gboolean types, const gchar *label)
+{
+  if (!die_tree_has_units (session, types))
+    return NULL;
+
+  DiePage *page = g_slice_new0 (DiePage);
+  page->session = session;
+  page->types = types;
+  page->box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  GtkWidget *tab = create_tab_label (label, &page->spinner);
+  g_object_ref (page->spinner);
+  g_object_set_data_full (G_OBJECT (page->box), "DiePage",
+                          page, die_page_free);
+
+  gtk_widget_show (page->box);
+  gtk_notebook_append_page (notebook, page->box, tab);
+  return page->box;
+}
+
+
+/* Switch to a session's view, adding its page the first time.  */
+static DiePage *
+show_die_page (GtkNotebook *notebook, DwarvishSession *session,
+               gboolean types)
+{
+  gint n_pages = gtk_notebook_get_n_pages (notebook);
+  for (gint i = 0; i < n_pages; ++i)
+    {
+      GtkWidget *box = gtk_notebook_get_nth_page (notebook, i);
+      DiePage *page = g_object_get_data (G_OBJECT (box), "DiePage");
+      if (page != NULL && page->session == session && page->types == types)
+        {
+          gtk_notebook_set_current_page (notebook, i);
+          return page;
+        }
+    }
+
+  gchar *label = g_strdup_printf ("%s %s", session->basename,
+                                  types ? "Types" : "Info");
+  GtkWidget *box = append_die_page (notebook, session, types, label);
+  g_free (label);
+  if (box == NULL)
+    return NULL;
+
+  gtk_notebook_set_current_page (notebook,
+                                 gtk_notebook_page_num (notebook, box));
+  return g_object_get_data (G_OBJECT (box), "DiePage");
+}
+
+
+/* Switch to a module's view from the module list.  */
+static void
+open_module_page (DwarvishSession *module, gboolean types, gpointer user_data)
+{
+  show_die_page (user_data, module, types);
+}
+
+
+/* Switch to the other view of a session, to follow a reference there.
+ * Switching pages creates its widget if need be.  */
+static GtkTreeView *
+open_die_view (DwarvishSession *session, gboolean types, gpointer user_data)
+{
+  DiePage *page = show_die_page (user_data, session, types);
+  if (page == NULL || page->widget == NULL)
+    return NULL;
+  return g_object_get_data (G_OBJECT (page->widget), "DieTreeView");
+}
+
+
 static GtkWidget *
 create_main_window (DwarvishSession *session)
 {
@@ -100,21 +349,35 @@ create_main_window (DwarvishSession *session)
   gtk_window_set_title (GTK_WINDOW (window), title);
   g_free (title);
 
-  /* Attach the .debug_info view.  */
-  GtkWidget *die_widget = create_die_widget (session, FALSE);
-  if (die_widget)
+  /* Attach the .debug_info and .debug_types pages, and fill in whichever
+   * is shown first.  */
+  if (session->modules != NULL)
     {
-      gtk_notebook_append_page (notebook, die_widget, gtk_label_new ("Info"));
-      g_object_unref (die_widget);
+      /* Only the module list is shown at first.  */
+      GtkWidget *modules = module_tree_widget_new (session, open_module_page,
+                                                   notebook);
+      gtk_notebook_append_page (notebook, modules,
+                                gtk_label_new ("Modules"));
     }
-
-  /* Attach the .debug_types view.  */
-  die_widget = create_die_widget (session, TRUE);
-  if (die_widget)
+  else
     {
-      gtk_notebook_append_page (notebook, die_widget, gtk_label_new ("Types"));
-      g_object_unref (die_widget);
+      append_die_page (notebook, session, FALSE, "Info");
+      append_die_page (notebook, session, TRUE, "Types");
     }
+  g_signal_connect (notebook, "switch-page",
+                    G_CALLBACK (signal_notebook_switch_page), NULL);
+  gint current = gtk_notebook_get_current_page (notebook);
+  if (current >= 0)
+    signal_notebook_switch_page (notebook,
+                                 gtk_notebook_get_nth_page (notebook,
+                                                            current),
+                                 current, NULL);
+
+  guint check_id = g_timeout_add_seconds (DIE_PAGE_CHECK_S,
+                                          die_pages_check, notebook);
+  g_object_set_data_full (G_OBJECT (notebook), "DiePagesCheck",
+                          GUINT_TO_POINTER (check_id),
+                          die_pages_check_remove);
 
   gtk_builder_connect_signals (builder, NULL);
 
@@ -139,70 +402,11 @@ exit_message (const char *message, gboolean usage)
 }
 
 
-static DwarvishSession *
-session_begin (void)
-{
-  return g_malloc0 (sizeof (DwarvishSession));
-}
-
-
-static void
-session_init_dwarf (DwarvishSession *session)
-{
-  session->dwfl = session->file ? load_elf_dwfl (session->file)
-    : load_kernel_dwfl (session->kernel, session->module);
-  session->dwflmod = get_first_module (session->dwfl);
-
-  if (session->dwflmod == NULL)
-    exit_message ("Couldn't load the requested target.", FALSE);
-
-  Dwarf_Addr bias;
-  session->dwarf = dwfl_module_getdwarf (session->dwflmod, &bias);
-  if (session->dwarf == NULL)
-    exit_message ("No DWARF found for the target.", FALSE);
-
-  const char *mainfile, *debugfile;
-  const char *modname = dwfl_module_info (session->dwflmod,
-                                          NULL, NULL, NULL, NULL, NULL,
-                                          &mainfile, &debugfile);
-  session->basename = g_path_get_basename (modname);
-  session->mainfile = canonicalize_file_name (mainfile);
-  session->debugfile = canonicalize_file_name (debugfile);
-
-  const char *debugaltfile = get_debugaltfile (session->dwarf);
-  if (debugaltfile != NULL)
-    {
-      if (g_path_is_absolute (debugaltfile))
-        session->debugaltfile = canonicalize_file_name (debugaltfile);
-      else
-        {
-          /* If not absolute, the path is relative the file with the Dwarf.  */
-          const char *file = session->debugfile ?: session->mainfile;
-          gchar *dirname = g_path_get_dirname (file);
-          gchar *altfile = g_build_filename (dirname, debugaltfile, NULL);
-          session->debugaltfile = canonicalize_file_name (altfile);
-          g_free (dirname);
-          g_free (altfile);
-        }
-    }
-}
-
-
-static void
-session_end (DwarvishSession *session)
+static gboolean
+start_name_index (gpointer data)
 {
-  g_free (session->kernel);
-  g_free (session->module);
-  g_free (session->file);
-
-  dwfl_end (session->dwfl);
-
-  g_free (session->basename);
-  free (session->mainfile);
-  free (session->debugfile);
-  free (session->debugaltfile);
-
-  g_free (session);
+  name_index_get (data, FALSE);
+  return G_SOURCE_REMOVE;
 }
 
 
@@ -229,6 +433,10 @@ main (int argc, char **argv)
   DwarvishSession *session = session_begin ();
 
   gchar **files = NULL;
+  gchar *dump = NULL;
+  gint jobs = 1;
+  gboolean profile = FALSE;
+  gchar *profile_trace = NULL;
   GError *error = NULL;
 
   GOptionEntry options[] =
@@ -253,6 +461,10 @@ main (int argc, char **argv)
           &session->explicit_siblings,
           "Show explicit sibling DIE attributes", NULL
         },
+        {
+          "attr-depth", 0, 0, G_OPTION_ARG_INT, &session->attr_depth,
+          "Prefetch attributes of referenced DIEs N levels deep", "N"
+        },
         {
           "kernel", 'k', 0, G_OPTION_ARG_FILENAME, &session->kernel,
           "Load the given kernel release", "RELEASE"
@@ -261,6 +473,28 @@ main (int argc, char **argv)
           "module", 'm', 0, G_OPTION_ARG_FILENAME, &session->module,
           "Load the given kernel module name", "MODULE"
         },
+        {
+          "modules", 0, 0, G_OPTION_ARG_STRING, &session->modules,
+          "List the kernel and its modules matching GLOB, each opened"
+          " when expanded", "GLOB"
+        },
+        {
+          "dump", 0, 0, G_OPTION_ARG_STRING, &dump,
+          "Write all DIEs to stdout as 'text' or 'json' lines, without"
+          " opening a window", "FORMAT"
+        },
+        {
+          "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+          "Dump units in N threads, or 0 for one per CPU up to 4", "N"
+        },
+        {
+          "profile", 0, 0, G_OPTION_ARG_NONE, &profile,
+          "Print the time spent in each phase on exit", NULL
+        },
+        {
+          "profile-trace", 0, 0, G_OPTION_ARG_FILENAME, &profile_trace,
+          "Also write the profile as Chrome trace events to FILE", "FILE"
+        },
         {
           G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files,
           "Load the given ELF file", "FILE"
@@ -268,14 +502,34 @@ main (int argc, char **argv)
         { NULL, 0, 0, 0, NULL, NULL, NULL }
     };
 
-  if (!gtk_init_with_args (&argc, &argv,
-                           "| [--kernel=RELEASE] [--module=MODULE]",
-                           options, NULL, &error))
+  /* The display is only opened after parsing, as a dump doesn't need it.  */
+  GOptionContext *context =
+    g_option_context_new ("| [--kernel=RELEASE] [--module=MODULE]");
+  g_option_context_add_main_entries (context, options, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (FALSE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
     exit_message (error ? error->message : NULL, TRUE);
+  g_option_context_free (context);
 
   if (session->nested_imports && session->explicit_imports)
     exit_message ("--nested-imports and --explicit-imports are exclusive.", TRUE);
 
+  if (session->attr_depth < 0)
+    exit_message ("--attr-depth must not be negative.", TRUE);
+
+  DumpFormat dump_format = DUMP_FORMAT_TEXT;
+  if (dump && !dump_parse_format (dump, &dump_format))
+    exit_message ("--dump must be 'text' or 'json'.", TRUE);
+
+  if (jobs < 0)
+    exit_message ("--jobs must not be negative.", TRUE);
+
+  if (session->modules && (files || session->module))
+    exit_message ("--modules can't be used with another target.", TRUE);
+
+  if (session->modules && dump)
+    exit_message ("--dump needs a single target, not --modules.", TRUE);
+
   if (files)
     {
       if (files[1] || session->kernel || session->module)
@@ -284,15 +538,46 @@ main (int argc, char **argv)
       g_strfreev (files);
     }
 
-  session_init_dwarf (session);
+  if (profile || profile_trace)
+    profile_start (profile_trace);
+  g_free (profile_trace);
+
+  gint64 start = profile_begin ();
+  const char *message = session_init_dwarf (session);
+  profile_end (start, "session init");
+  if (message != NULL)
+    exit_message (message, FALSE);
 
+  if (dump)
+    {
+      start = profile_begin ();
+      gboolean ok = dump_session (session, dump_format, jobs);
+      profile_end (start, "dump");
+      g_free (dump);
+      session_end (session);
+      ok = profile_finish () && ok;
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  if (!gtk_init_check (&argc, &argv))
+    exit_message ("Couldn't open the display.", FALSE);
+
+  start = profile_begin ();
   GtkWidget *window = create_main_window (session);
   gtk_widget_show_all (window);
+  profile_end (start, "create main window");
+
+  /* Have names ready for searching, and saved for next time.  A module
+   * list has no DWARF of its own to index.  */
+  if (session->dwarf != NULL)
+    g_idle_add (start_name_index, session);
   gtk_main ();
 
+  /* Destroying the views also stops their background loaders.  */
+  gtk_widget_destroy (window);
   session_end (session);
 
-  return EXIT_SUCCESS;
+  return profile_finish () ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 
@@ -0,0 +1,226 @@
+/*
+ * Kernel module list implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "moduletree.h"
+#include "dietree.h"
+#include "profile.h"
+
+
+/* Every reported module is a top-level row, with an empty placeholder row
+ * below it until it's expanded.  Only then is its DWARF opened, and the
+ * placeholder replaced by a row for each of its views, which are opened
+ * in the notebook when activated.  */
+enum
+{
+  MODULE_TREE_COL_NAME = 0,
+  MODULE_TREE_COL_FILE,
+  MODULE_TREE_COL_MODULE,       /* Dwfl_Module *, for module rows.  */
+  MODULE_TREE_COL_SESSION,      /* DwarvishSession *, once opened.  */
+  MODULE_TREE_COL_TYPES,        /* gint, for view rows, else -1.  */
+  MODULE_TREE_N_COLUMNS
+};
+
+typedef struct _ModuleTree
+{
+  DwarvishSession *session;
+  ModuleTreeOpenFunc open;
+  gpointer user_data;
+} ModuleTree;
+
+
+static int
+module_tree_add_module (Dwfl_Module *dwflmod,
+                        G_GNUC_UNUSED void **userdata,
+                        const char *name,
+                        G_GNUC_UNUSED Dwarf_Addr start,
+                        void *arg)
+{
+  GtkTreeStore *store = arg;
+
+  const char *mainfile;
+  dwfl_module_info (dwflmod, NULL, NULL, NULL, NULL, NULL, &mainfile, NULL);
+
+  GtkTreeIter iter, placeholder;
+  gtk_tree_store_insert_with_values (store, &iter, NULL, -1,
+                                     MODULE_TREE_COL_NAME, name,
+                                     MODULE_TREE_COL_FILE, mainfile,
+                                     MODULE_TREE_COL_MODULE, dwflmod,
+                                     MODULE_TREE_COL_TYPES, -1,
+                                     -1);
+  gtk_tree_store_insert_with_values (store, &placeholder, &iter, -1,
+                                     MODULE_TREE_COL_TYPES, -1,
+                                     -1);
+  return DWARF_CB_OK;
+}
+
+
+static void
+module_tree_add_view (GtkTreeStore *store, GtkTreeIter *parent,
+                      DwarvishSession *module, gboolean types)
+{
+  if (!die_tree_has_units (module, types))
+    return;
+
+  GtkTreeIter iter;
+  gtk_tree_store_insert_with_values (store, &iter, parent, -1,
+                                     MODULE_TREE_COL_NAME,
+                                     types ? "Types" : "Info",
+                                     MODULE_TREE_COL_SESSION, module,
+                                     MODULE_TREE_COL_TYPES, types,
+                                     -1);
+}
+
+
+/* Open a module's DWARF the first time its row is expanded.  */
+static gboolean
+signal_module_tree_test_expand_row (GtkTreeView *view, GtkTreeIter *iter,
+                                    G_GNUC_UNUSED GtkTreePath *path,
+                                    gpointer user_data)
+{
+  ModuleTree *tree = user_data;
+  GtkTreeStore *store = GTK_TREE_STORE (gtk_tree_view_get_model (view));
+  GtkTreeModel *model = GTK_TREE_MODEL (store);
+
+  Dwfl_Module *dwflmod;
+  GtkTreeIter child;
+  gchar *name = NULL;
+  gtk_tree_model_get (model, iter, MODULE_TREE_COL_MODULE, &dwflmod, -1);
+  if (dwflmod == NULL || !gtk_tree_model_iter_children (model, &child, iter))
+    return FALSE;
+  gtk_tree_model_get (model, &child, MODULE_TREE_COL_NAME, &name, -1);
+  if (name != NULL)
+    {
+      /* It's already open.  */
+      g_free (name);
+      return FALSE;
+    }
+
+  const char *error;
+  gint64 start = profile_begin ();
+  DwarvishSession *module = session_open_module (tree->session, dwflmod,
+                                                 &error);
+  profile_end (start, "open module");
+
+  gtk_tree_store_remove (store, &child);
+  if (module == NULL)
+    {
+      gtk_tree_store_insert_with_values (store, &child, iter, -1,
+                                         MODULE_TREE_COL_NAME, error,
+                                         MODULE_TREE_COL_TYPES, -1,
+                                         -1);
+      return FALSE;
+    }
+
+  gtk_tree_store_set (store, iter,
+                      MODULE_TREE_COL_FILE,
+                      module->debugfile ?: module->mainfile,
+                      MODULE_TREE_COL_SESSION, module,
+                      -1);
+  module_tree_add_view (store, iter, module, FALSE);
+  module_tree_add_view (store, iter, module, TRUE);
+  return FALSE;
+}
+
+
+/* Activating a module expands it, and activating a view shows it.  */
+static void
+signal_module_tree_row_activated (GtkTreeView *view, GtkTreePath *path,
+                                  G_GNUC_UNUSED GtkTreeViewColumn *column,
+                                  gpointer user_data)
+{
+  ModuleTree *tree = user_data;
+  GtkTreeModel *model = gtk_tree_view_get_model (view);
+
+  GtkTreeIter iter;
+  DwarvishSession *module;
+  gint types;
+  if (!gtk_tree_model_get_iter (model, &iter, path))
+    return;
+  gtk_tree_model_get (model, &iter,
+                      MODULE_TREE_COL_SESSION, &module,
+                      MODULE_TREE_COL_TYPES, &types,
+                      -1);
+
+  if (types >= 0)
+    tree->open (module, types, tree->user_data);
+  else if (gtk_tree_view_row_expanded (view, path))
+    gtk_tree_view_collapse_row (view, path);
+  else
+    gtk_tree_view_expand_row (view, path, FALSE);
+}
+
+
+static void
+module_tree_add_column (GtkTreeView *view, const gchar *title, gint column)
+{
+  GtkCellRenderer *renderer = gtk_cell_renderer_text_new ();
+  g_object_set (renderer, "font", "monospace 9", NULL);
+  gtk_tree_view_insert_column_with_attributes (view, -1, title, renderer,
+                                               "text", column, NULL);
+}
+
+
+static void
+module_tree_free (gpointer data)
+{
+  g_slice_free (ModuleTree, data);
+}
+
+
+/* List the modules of a session, which are all reported but not yet
+ * opened.  The opened modules' sessions belong to this session.  */
+GtkWidget *
+module_tree_widget_new (DwarvishSession *session, ModuleTreeOpenFunc open,
+                        gpointer user_data)
+{
+  ModuleTree *tree = g_slice_new0 (ModuleTree);
+  tree->session = session;
+  tree->open = open;
+  tree->user_data = user_data;
+
+  GtkTreeStore *store = gtk_tree_store_new (MODULE_TREE_N_COLUMNS,
+                                            G_TYPE_STRING, G_TYPE_STRING,
+                                            G_TYPE_POINTER, G_TYPE_POINTER,
+                                            G_TYPE_INT);
+  dwfl_getmodules (session->dwfl, module_tree_add_module, store, 0);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store),
+                                        MODULE_TREE_COL_NAME,
+                                        GTK_SORT_ASCENDING);
+
+  GtkWidget *view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+  g_object_unref (store); /* The view keeps its own reference.  */
+  g_object_set_data_full (G_OBJECT (view), "ModuleTree",
+                          tree, module_tree_free);
+  gtk_tree_view_set_search_column (GTK_TREE_VIEW (view),
+                                   MODULE_TREE_COL_NAME);
+  module_tree_add_column (GTK_TREE_VIEW (view), "Module",
+                          MODULE_TREE_COL_NAME);
+  module_tree_add_column (GTK_TREE_VIEW (view), "File",
+                          MODULE_TREE_COL_FILE);
+
+  g_signal_connect (view, "test-expand-row",
+                    G_CALLBACK (signal_module_tree_test_expand_row), tree);
+  g_signal_connect (view, "row-activated",
+                    G_CALLBACK (signal_module_tree_row_activated), tree);
+
+  GtkWidget *scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled),
+                                       GTK_SHADOW_IN);
+  gtk_container_add (GTK_CONTAINER (scrolled), view);
+  gtk_widget_show_all (scrolled);
+  return scrolled;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
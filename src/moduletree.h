@@ -0,0 +1,33 @@
+/*
+ * Kernel module list interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _MODULETREE_H_
+#define _MODULETREE_H_
+
+#include <gtk/gtk.h>
+
+#include "session.h"
+
+
+/* Called to show a module's .debug_info or .debug_types view.  */
+typedef void (*ModuleTreeOpenFunc) (DwarvishSession *module,
+                                    gboolean types,
+                                    gpointer user_data);
+
+G_GNUC_INTERNAL
+GtkWidget *module_tree_widget_new (DwarvishSession *session,
+                                   ModuleTreeOpenFunc open,
+                                   gpointer user_data);
+
+
+#endif /* _MODULETREE_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
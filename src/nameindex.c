@@ -0,0 +1,527 @@
+/*
+ * DIE name index implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dwarf.h>
+#include "indexcache.h"
+#include "nameindex.h"
+#include "profile.h"
+
+
+/* Every DW_AT_name and linkage name is indexed, sorted by name so prefixes
+ * are a binary search away.  Substrings are matched by scanning each
+ * distinct name once.  The arrays are laid out as in the index cache, so
+ * they're either built here or used straight from there.  */
+#define NAME_ALT_BIT ((Dwarf_Off) 1 << 63)
+#define NAME_MAX_THREADS 4
+
+/* Names found by a worker still point into .debug_str.  */
+typedef struct _NameRaw
+{
+  const char *name;
+  Dwarf_Off offset;
+} NameRaw;
+
+typedef struct _NameWork
+{
+  GArray *names;        /* NameRaw, sorted by name.  */
+  GArray *parents;      /* IndexCacheParent, for the cache.  */
+} NameWork;
+
+struct _NameIndex
+{
+  DwarvishSession *session;
+  gboolean types;
+  Dwarf *alt;
+
+  GArray *units;        /* Dwarf_Off of every unit to walk, maybe alt.  */
+  GArray *unit_table;   /* IndexCacheUnit of the main units, for the cache.  */
+  gint next_unit;       /* Claimed by workers atomically.  */
+  gint cancelled;
+  gint ready;
+  GThread *thread;
+
+  const NameEntry *entries;     /* Sorted by name.  */
+  gsize n_entries;
+  const guint32 *names;         /* The first entry of each distinct name.  */
+  gsize n_names;
+  const char *strings;
+
+  /* Storage for the above, unless they're mapped from the cache.  */
+  GArray *entry_array;
+  GArray *name_array;
+  GString *string_array;
+};
+
+
+static int
+name_raw_compare (const void *a, const void *b)
+{
+  const NameRaw *ra = a, *rb = b;
+  int cmp = strcmp (ra->name, rb->name);
+  if (cmp == 0)
+    cmp = (ra->offset > rb->offset) - (ra->offset < rb->offset);
+  return cmp;
+}
+
+
+static int
+name_parent_compare (const void *a, const void *b)
+{
+  const IndexCacheParent *pa = a, *pb = b;
+  return (pa->offset > pb->offset) - (pa->offset < pb->offset);
+}
+
+
+static void
+name_index_add (NameWork *work, const char *name, Dwarf_Off offset)
+{
+  NameRaw raw = { name, offset };
+  if (name != NULL && *name != '\0')
+    g_array_append_val (work->names, raw);
+}
+
+
+static void
+name_index_walk (NameWork *work, Dwarf_Die *die, Dwarf_Off alt,
+                 GArray *parents, Dwarf_Off parent)
+{
+  Dwarf_Attribute attr;
+  Dwarf_Off offset = dwarf_dieoffset (die);
+  const char *name = dwarf_formstring (dwarf_attr (die, DW_AT_name, &attr));
+  const char *linkage =
+    dwarf_formstring (dwarf_attr (die, DW_AT_linkage_name, &attr)
+                      ?: dwarf_attr (die, DW_AT_MIPS_linkage_name, &attr));
+
+  name_index_add (work, name, offset | alt);
+  if (linkage != NULL && (name == NULL || strcmp (name, linkage) != 0))
+    name_index_add (work, linkage, offset | alt);
+
+  if (parents != NULL)
+    {
+      IndexCacheParent entry = { offset, parent };
+      g_array_append_val (parents, entry);
+    }
+
+  Dwarf_Die child;
+  if (dwarf_child (die, &child) == 0)
+    do
+      name_index_walk (work, &child, alt, parents, offset);
+    while (dwarf_siblingof (&child, &child) == 0);
+}
+
+
+/* Each worker claims whole units until none are left, then sorts what it
+ * found.  Libdw handles aren't safe to share between threads, so each
+ * reads a clone of the session, begun here rather than holding up the
+ * others.  The names point into .debug_str of the Elf it shares with the
+ * session, so the clone can be ended before they're merged.  Parents are
+ * recorded for the main .debug_info, like dieindex.c does per unit.  */
+static gpointer
+name_index_worker (gpointer data)
+{
+  NameIndex *index = data;
+  typeof (dwarf_offdie) *offdie = index->types ? dwarf_offdie_types
+    : dwarf_offdie;
+  NameWork *work = g_slice_new (NameWork);
+  work->names = g_array_new (FALSE, FALSE, sizeof (NameRaw));
+  work->parents = g_array_new (FALSE, FALSE, sizeof (IndexCacheParent));
+
+  const char *error;
+  DwarvishSession *clone = session_clone (index->session, &error);
+  if (clone == NULL)
+    return work;
+
+  guint i;
+  while (!g_atomic_int_get (&index->cancelled)
+         && (i = g_atomic_int_add (&index->next_unit, 1)) < index->units->len)
+    {
+      Dwarf_Off offset = g_array_index (index->units, Dwarf_Off, i);
+      gboolean alt = (offset & NAME_ALT_BIT) != 0;
+      Dwarf *dwarf = alt ? clone->altdwarf : clone->dwarf;
+      Dwarf_Die unit;
+      if (dwarf == NULL
+          || offdie (dwarf, offset & ~NAME_ALT_BIT, &unit) == NULL)
+        continue;
+      name_index_walk (work, &unit, alt ? NAME_ALT_BIT : 0,
+                       (alt || index->types) ? NULL : work->parents,
+                       dwarf_dieoffset (&unit));
+    }
+
+  session_end (clone);
+  qsort (work->names->data, work->names->len, sizeof (NameRaw),
+         name_raw_compare);
+  return work;
+}
+
+
+/* Merge the sorted results of each worker, copying each distinct name
+ * into the strings.  There are only a few workers, so the smallest head
+ * is simply found by a linear scan.  */
+static void
+name_index_merge (NameIndex *index, NameWork **works, guint n_works)
+{
+  guint total = 0;
+  for (guint i = 0; i < n_works; ++i)
+    total += works[i]->names->len;
+
+  index->entry_array = g_array_sized_new (FALSE, FALSE, sizeof (NameEntry),
+                                          total);
+  index->name_array = g_array_new (FALSE, FALSE, sizeof (guint32));
+  index->string_array = g_string_new (NULL);
+
+  const char *last = NULL;
+  guint heads[NAME_MAX_THREADS] = { 0 };
+  for (;;)
+    {
+      NameRaw *best = NULL;
+      guint best_work = 0;
+      for (guint i = 0; i < n_works; ++i)
+        if (heads[i] < works[i]->names->len)
+          {
+            NameRaw *raw = &g_array_index (works[i]->names, NameRaw, heads[i]);
+            if (best == NULL || name_raw_compare (raw, best) < 0)
+              {
+                best = raw;
+                best_work = i;
+              }
+          }
+
+      if (best == NULL)
+        break;
+      ++heads[best_work];
+
+      if (last == NULL || strcmp (last, best->name) != 0)
+        {
+          guint32 first = index->entry_array->len;
+          g_array_append_val (index->name_array, first);
+          last = best->name;
+          g_string_append_len (index->string_array, last, strlen (last) + 1);
+        }
+
+      NameEntry entry =
+        {
+          index->string_array->len - strlen (last) - 1,
+          best->offset
+        };
+      g_array_append_val (index->entry_array, entry);
+    }
+}
+
+
+static void
+name_index_save (NameIndex *index, NameWork **works, guint n_works)
+{
+  GArray *parents = g_array_new (FALSE, FALSE, sizeof (IndexCacheParent));
+  for (guint i = 0; i < n_works; ++i)
+    g_array_append_vals (parents, works[i]->parents->data,
+                         works[i]->parents->len);
+  qsort (parents->data, parents->len, sizeof (IndexCacheParent),
+         name_parent_compare);
+
+  IndexCacheBlob blobs[INDEX_CACHE_N_SECTIONS] =
+    {
+      [INDEX_CACHE_UNITS] =
+        { index->unit_table->data, index->unit_table->len },
+      [INDEX_CACHE_NAMES] = { index->entries, index->n_entries },
+      [INDEX_CACHE_NAME_FIRSTS] = { index->names, index->n_names },
+      [INDEX_CACHE_STRINGS] =
+        { index->string_array->str, index->string_array->len },
+      [INDEX_CACHE_PARENTS] = { parents->data, parents->len },
+    };
+  index_cache_write (index->session->index_caches[index->types], blobs);
+  g_array_free (parents, TRUE);
+}
+
+
+/* Each worker has its own libdw tables, so only use a few, and leave
+ * half the processors for the rest of the program.  */
+static guint
+name_index_n_threads (void)
+{
+  long n = sysconf (_SC_NPROCESSORS_ONLN) / 2;
+  return CLAMP (n, 1, NAME_MAX_THREADS);
+}
+
+
+static gpointer
+name_index_thread (gpointer data)
+{
+  NameIndex *index = data;
+  gint64 start = profile_begin ();
+
+  guint n_threads = name_index_n_threads ();
+  GThread *threads[NAME_MAX_THREADS];
+  for (guint i = 0; i < n_threads; ++i)
+    threads[i] = g_thread_new ("dwarvish-names", name_index_worker, index);
+
+  NameWork *works[NAME_MAX_THREADS];
+  for (guint i = 0; i < n_threads; ++i)
+    works[i] = g_thread_join (threads[i]);
+
+  /* If no worker could begin, the units were never claimed, and the
+   * index is left empty rather than saved that way.  */
+  if (!g_atomic_int_get (&index->cancelled)
+      && (guint) g_atomic_int_get (&index->next_unit) >= index->units->len)
+    {
+      name_index_merge (index, works, n_threads);
+      index->entries = (const NameEntry *) index->entry_array->data;
+      index->n_entries = index->entry_array->len;
+      index->names = (const guint32 *) index->name_array->data;
+      index->n_names = index->name_array->len;
+      index->strings = index->string_array->str;
+
+      /* Searches can go ahead while the cache is written.  */
+      g_atomic_int_set (&index->ready, TRUE);
+      profile_end (start, "build name index");
+      start = profile_begin ();
+      name_index_save (index, works, n_threads);
+      profile_end (start, "save name index");
+    }
+
+  for (guint i = 0; i < n_threads; ++i)
+    {
+      g_array_free (works[i]->names, TRUE);
+      g_array_free (works[i]->parents, TRUE);
+      g_slice_free (NameWork, works[i]);
+    }
+
+  g_atomic_int_set (&index->ready, TRUE);
+  return NULL;
+}
+
+
+static void
+name_index_add_units (NameIndex *index, Dwarf *dwarf)
+{
+  gboolean types = index->types;
+  Dwarf_Off alt = dwarf == index->alt ? NAME_ALT_BIT : 0;
+  IndexCacheUnit entry = { 0, 0, 0 };
+
+  size_t cuhl;
+  Dwarf_Off type_offset = 0;
+  for (Dwarf_Off noff, off = 0;
+       dwarf_next_unit (dwarf, off, &noff, &cuhl, NULL, NULL, NULL, NULL,
+                        types ? &entry.type_signature : NULL,
+                        types ? &type_offset : NULL) == 0;
+       off = noff)
+    {
+      Dwarf_Off unit = (off + cuhl) | alt;
+      g_array_append_val (index->units, unit);
+
+      entry.offset = off + cuhl;
+      entry.type_offset = types ? off + type_offset : 0;
+      if (dwarf == index->session->dwarf)
+        g_array_append_val (index->unit_table, entry);
+    }
+}
+
+
+/* Use the names from the cache, after checking they don't point outside
+ * its own arrays.  */
+static gboolean
+name_index_load_cache (NameIndex *index)
+{
+  IndexCache *cache = index->session->index_caches[index->types];
+  gsize n_strings;
+  const NameEntry *entries = index_cache_section (cache, INDEX_CACHE_NAMES,
+                                                  &index->n_entries);
+  const guint32 *names = index_cache_section (cache, INDEX_CACHE_NAME_FIRSTS,
+                                              &index->n_names);
+  const char *strings = index_cache_section (cache, INDEX_CACHE_STRINGS,
+                                             &n_strings);
+  if (entries == NULL || names == NULL || strings == NULL)
+    return FALSE;
+
+  for (gsize i = 0; i < index->n_entries; ++i)
+    if (entries[i].name >= n_strings)
+      return FALSE;
+  for (gsize i = 0; i < index->n_names; ++i)
+    if (names[i] >= index->n_entries)
+      return FALSE;
+
+  index->entries = entries;
+  index->names = names;
+  index->strings = strings;
+  index->ready = TRUE;
+  return TRUE;
+}
+
+
+/* Get the name index, starting to build it in the background if needed.  */
+NameIndex *
+name_index_get (DwarvishSession *session, gboolean types)
+{
+  types = !!types;
+  NameIndex *index = session->name_indexes[types];
+  if (index != NULL)
+    return index;
+
+  index = g_slice_new0 (NameIndex);
+  index->session = session;
+  index->types = types;
+  session->name_indexes[types] = index;
+
+  if (!types)
+    index->alt = session->altdwarf;
+  if (name_index_load_cache (index))
+    return index;
+
+  index->units = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+  index->unit_table = g_array_new (FALSE, FALSE, sizeof (IndexCacheUnit));
+
+  /* Only the unit headers are read here, on the main thread.  The workers
+   * read the DIEs with their own handles.  */
+  name_index_add_units (index, session->dwarf);
+  if (index->alt != NULL)
+    name_index_add_units (index, index->alt);
+
+  index->thread = g_thread_new ("dwarvish-names", name_index_thread, index);
+  return index;
+}
+
+
+gboolean
+name_index_ready (NameIndex *index)
+{
+  return g_atomic_int_get (&index->ready);
+}
+
+
+const char *
+name_index_entry_name (NameIndex *index, const NameEntry *entry)
+{
+  return index->strings + entry->name;
+}
+
+
+static inline const char *
+name_index_name (NameIndex *index, gsize name)
+{
+  return name_index_entry_name (index, &index->entries[index->names[name]]);
+}
+
+
+static gboolean
+name_index_append_name (NameIndex *index, gsize name, guint limit,
+                        GArray *matches)
+{
+  gsize end = (name + 1 < index->n_names
+               ? index->names[name + 1] : index->n_entries);
+  for (gsize i = index->names[name]; i < end; ++i)
+    {
+      if (matches->len >= limit)
+        return FALSE;
+      g_array_append_vals (matches, &index->entries[i], 1);
+    }
+  return TRUE;
+}
+
+
+/* Find entries whose name starts with the text, then any others which
+ * contain it, up to the limit.  Returns the number of matches found.  */
+guint
+name_index_search (NameIndex *index, const char *text, guint limit,
+                   GArray *matches)
+{
+  g_array_set_size (matches, 0);
+  if (!name_index_ready (index) || index->names == NULL || *text == '\0')
+    return 0;
+
+  size_t len = strlen (text);
+
+  /* Find the first distinct name which isn't less than the text.  */
+  gsize lo = 0, hi = index->n_names;
+  while (lo < hi)
+    {
+      gsize mid = lo + (hi - lo) / 2;
+      if (strcmp (name_index_name (index, mid), text) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  gsize name;
+  for (name = lo; name < index->n_names; ++name)
+    {
+      if (strncmp (name_index_name (index, name), text, len) != 0)
+        break;
+      if (!name_index_append_name (index, name, limit, matches))
+        return matches->len;
+    }
+
+  for (gsize i = 0; i < index->n_names; ++i)
+    {
+      if (i >= lo && i < name)
+        continue; /* Already matched as a prefix.  */
+      if (strstr (name_index_name (index, i), text) != NULL
+          && !name_index_append_name (index, i, limit, matches))
+        break;
+    }
+
+  return matches->len;
+}
+
+
+gboolean
+name_index_get_die (NameIndex *index, const NameEntry *entry, Dwarf_Die *die)
+{
+  Dwarf *dwarf = index->session->dwarf;
+  if (entry->offset & NAME_ALT_BIT)
+    dwarf = index->alt;
+
+  Dwarf_Off offset = entry->offset & ~NAME_ALT_BIT;
+  if (dwarf == NULL)
+    return FALSE;
+  if (index->types)
+    return dwarf_offdie_types (dwarf, offset, die) != NULL;
+  return dwarf_offdie (dwarf, offset, die) != NULL;
+}
+
+
+static void
+name_index_destroy (NameIndex *index)
+{
+  if (index->thread != NULL)
+    {
+      g_atomic_int_set (&index->cancelled, TRUE);
+      g_thread_join (index->thread);
+    }
+
+  if (index->units != NULL)
+    g_array_free (index->units, TRUE);
+  if (index->unit_table != NULL)
+    g_array_free (index->unit_table, TRUE);
+  if (index->entry_array != NULL)
+    g_array_free (index->entry_array, TRUE);
+  if (index->name_array != NULL)
+    g_array_free (index->name_array, TRUE);
+  if (index->string_array != NULL)
+    g_string_free (index->string_array, TRUE);
+  g_slice_free (NameIndex, index);
+}
+
+
+void
+name_index_free (DwarvishSession *session)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (session->name_indexes); ++i)
+    if (session->name_indexes[i] != NULL)
+      name_index_destroy (session->name_indexes[i]);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,58 @@
+/*
+ * DIE name index interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _NAMEINDEX_H_
+#define _NAMEINDEX_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+typedef struct _NameIndex NameIndex;
+
+typedef struct _NameEntry
+{
+  guint64 name;         /* Offset in the index's strings.  */
+  Dwarf_Off offset;     /* With the high bit set for the alt file.  */
+} NameEntry;
+
+
+G_GNUC_INTERNAL
+NameIndex *name_index_get (DwarvishSession *session,
+                           gboolean types);
+
+G_GNUC_INTERNAL
+gboolean name_index_ready (NameIndex *index);
+
+G_GNUC_INTERNAL
+guint name_index_search (NameIndex *index,
+                         const char *text,
+                         guint limit,
+                         GArray *matches);
+
+G_GNUC_INTERNAL
+const char *name_index_entry_name (NameIndex *index,
+                                   const NameEntry *entry);
+
+G_GNUC_INTERNAL
+gboolean name_index_get_die (NameIndex *index,
+                             const NameEntry *entry,
+                             Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+void name_index_free (DwarvishSession *session);
+
+
+#endif /* _NAMEINDEX_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
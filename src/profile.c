@@ -0,0 +1,267 @@
+/*
+ * Startup and rendering profile implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include "profile.h"
+
+
+/* With --profile, each phase records its span as it ends, from whatever
+ * thread it ran on, and the counters are bumped along the way.  Spans are
+ * totalled by name for the summary printed on exit, and the first of them
+ * are also kept in order for a Chrome trace-event file, which can be loaded
+ * in chrome://tracing.  */
+#define PROFILE_MAX_EVENTS (1 << 20)
+
+typedef struct _ProfileEvent
+{
+  const char *name;
+  gint64 start;
+  gint64 duration;
+  guint tid;
+} ProfileEvent;
+
+typedef struct _ProfilePhase
+{
+  const char *name;
+  guint64 count;
+  gint64 total;
+  gint64 max;
+} ProfilePhase;
+
+typedef struct _Profile
+{
+  gchar *trace_file;
+  gint64 start;
+
+  GMutex lock;
+  GArray *events;       /* ProfileEvent, for the trace file.  */
+  guint64 dropped;      /* Events past PROFILE_MAX_EVENTS.  */
+  GArray *phases;       /* ProfilePhase, in order of first appearance.  */
+  GHashTable *phase_index;      /* Name to index in phases, plus one.  */
+  guint n_threads;
+
+  guint64 counters[PROFILE_N_COUNTERS];
+} Profile;
+
+static const char *const profile_counter_names[PROFILE_N_COUNTERS] =
+{
+  [PROFILE_DIES_VISITED] = "DIEs visited",
+  [PROFILE_ROWS_INSERTED] = "rows inserted",
+  [PROFILE_ATTRS_RENDERED] = "attributes rendered",
+  [PROFILE_TYPENAME_HITS] = "typename cache hits",
+  [PROFILE_TYPENAME_MISSES] = "typenames computed",
+  [PROFILE_INDEX_CACHE_HITS] = "index cache hits",
+  [PROFILE_INDEX_CACHE_MISSES] = "index cache misses",
+};
+
+gboolean profile_enabled = FALSE;
+static Profile profile;
+static GPrivate profile_tid = G_PRIVATE_INIT (NULL);
+
+
+/* Start profiling, and also write a trace on finishing if given a file.
+ * This must be called before any other threads are started.  */
+void
+profile_start (const char *trace_file)
+{
+  profile.trace_file = g_strdup (trace_file);
+  profile.start = g_get_monotonic_time ();
+  g_mutex_init (&profile.lock);
+  profile.events = g_array_new (FALSE, FALSE, sizeof (ProfileEvent));
+  profile.phases = g_array_new (FALSE, FALSE, sizeof (ProfilePhase));
+  profile.phase_index = g_hash_table_new (g_str_hash, g_str_equal);
+  profile_enabled = TRUE;
+}
+
+
+/* Get the start time of a span, or 0 if not profiling.  */
+gint64
+profile_begin (void)
+{
+  return profile_enabled ? g_get_monotonic_time () : 0;
+}
+
+
+/* Threads are numbered as they first record something, the main thread
+ * usually being first.  Must be called with the lock held.  */
+static guint
+profile_thread_id (void)
+{
+  guint tid = GPOINTER_TO_UINT (g_private_get (&profile_tid));
+  if (tid == 0)
+    {
+      tid = ++profile.n_threads;
+      g_private_set (&profile_tid, GUINT_TO_POINTER (tid));
+    }
+  return tid;
+}
+
+
+/* Record a span from profile_begin until now.  The name must be static.  */
+void
+profile_end (gint64 start, const char *name)
+{
+  if (!profile_enabled || start == 0)
+    return;
+
+  gint64 duration = g_get_monotonic_time () - start;
+
+  g_mutex_lock (&profile.lock);
+  if (!profile_enabled)
+    {
+      /* It finished meanwhile.  */
+      g_mutex_unlock (&profile.lock);
+      return;
+    }
+
+  ProfilePhase *phase;
+  guint index = GPOINTER_TO_UINT (g_hash_table_lookup (profile.phase_index,
+                                                       name));
+  if (index == 0)
+    {
+      ProfilePhase new_phase = { name, 0, 0, 0 };
+      g_array_append_val (profile.phases, new_phase);
+      index = profile.phases->len;
+      g_hash_table_insert (profile.phase_index, (gpointer) name,
+                           GUINT_TO_POINTER (index));
+    }
+  phase = &g_array_index (profile.phases, ProfilePhase, index - 1);
+  ++phase->count;
+  phase->total += duration;
+  phase->max = MAX (phase->max, duration);
+
+  if (profile.events->len < PROFILE_MAX_EVENTS)
+    {
+      ProfileEvent event = { name, start, duration, profile_thread_id () };
+      g_array_append_val (profile.events, event);
+    }
+  else
+    ++profile.dropped;
+
+  g_mutex_unlock (&profile.lock);
+}
+
+
+void
+profile_add (ProfileCounter counter, guint64 n)
+{
+  __sync_fetch_and_add (&profile.counters[counter], n);
+}
+
+
+static void
+profile_print_summary (void)
+{
+  gint64 elapsed = g_get_monotonic_time () - profile.start;
+  g_printerr ("%s profile, %.1f ms in total:\n",
+              g_get_application_name (), elapsed / 1000.0);
+
+  g_printerr ("  %-28s %10s %12s %12s\n", "phase", "count",
+              "total ms", "max ms");
+  for (guint i = 0; i < profile.phases->len; ++i)
+    {
+      ProfilePhase *phase = &g_array_index (profile.phases, ProfilePhase, i);
+      g_printerr ("  %-28s %10" G_GUINT64_FORMAT " %12.1f %12.1f\n",
+                  phase->name, phase->count,
+                  phase->total / 1000.0, phase->max / 1000.0);
+    }
+
+  g_printerr ("  %-28s %10s\n", "counter", "count");
+  for (guint i = 0; i < PROFILE_N_COUNTERS; ++i)
+    g_printerr ("  %-28s %10" G_GUINT64_FORMAT "\n",
+                profile_counter_names[i], profile.counters[i]);
+
+  guint64 hits = profile.counters[PROFILE_TYPENAME_HITS];
+  guint64 lookups = hits + profile.counters[PROFILE_TYPENAME_MISSES];
+  if (lookups > 0)
+    g_printerr ("  %-28s %9.1f%%\n", "typename cache hit rate",
+                100.0 * hits / lookups);
+
+  hits = profile.counters[PROFILE_INDEX_CACHE_HITS];
+  lookups = hits + profile.counters[PROFILE_INDEX_CACHE_MISSES];
+  if (lookups > 0)
+    g_printerr ("  %-28s %9.1f%%\n", "index cache hit rate",
+                100.0 * hits / lookups);
+
+  if (profile.dropped > 0)
+    g_printerr ("  (%" G_GUINT64_FORMAT " spans left out of the trace)\n",
+                profile.dropped);
+}
+
+
+/* Spans are "complete" events, and the counters' final values are given
+ * as a single counter event at the end.  */
+static gboolean
+profile_write_trace (void)
+{
+  FILE *file = fopen (profile.trace_file, "w");
+  if (file == NULL)
+    return FALSE;
+
+  int pid = getpid ();
+  fputs ("{\"traceEvents\":[\n", file);
+  for (guint i = 0; i < profile.events->len; ++i)
+    {
+      ProfileEvent *event = &g_array_index (profile.events, ProfileEvent, i);
+      fprintf (file, "{\"name\":\"%s\",\"cat\":\"dwarvish\",\"ph\":\"X\","
+               "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+               "\"pid\":%d,\"tid\":%u},\n", event->name,
+               event->start - profile.start, event->duration,
+               pid, event->tid);
+    }
+
+  fprintf (file, "{\"name\":\"counters\",\"ph\":\"C\","
+           "\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"args\":{",
+           g_get_monotonic_time () - profile.start, pid);
+  for (guint i = 0; i < PROFILE_N_COUNTERS; ++i)
+    fprintf (file, "%s\"%s\":%" G_GUINT64_FORMAT, i ? "," : "",
+             profile_counter_names[i], profile.counters[i]);
+  fputs ("}}\n]}\n", file);
+
+  return fclose (file) == 0;
+}
+
+
+/* Print the summary, and write the trace if requested.  Spans from threads
+ * still running are just left out.  */
+gboolean
+profile_finish (void)
+{
+  if (!profile_enabled)
+    return TRUE;
+
+  g_mutex_lock (&profile.lock);
+  profile_enabled = FALSE;
+  g_mutex_unlock (&profile.lock);
+
+  profile_print_summary ();
+
+  gboolean ok = TRUE;
+  if (profile.trace_file != NULL && !profile_write_trace ())
+    {
+      g_printerr ("%s: Couldn't write the trace to %s\n",
+                  g_get_application_name (), profile.trace_file);
+      ok = FALSE;
+    }
+
+  g_hash_table_destroy (profile.phase_index);
+  g_array_free (profile.phases, TRUE);
+  g_array_free (profile.events, TRUE);
+  g_free (profile.trace_file);
+  return ok;
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
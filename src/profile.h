@@ -0,0 +1,59 @@
+/*
+ * Startup and rendering profile interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <glib.h>
+
+
+typedef enum
+{
+  PROFILE_DIES_VISITED = 0,     /* Children read to fill tree rows.  */
+  PROFILE_ROWS_INSERTED,        /* Tree rows, including top-level units.  */
+  PROFILE_ATTRS_RENDERED,       /* Attribute values turned into strings.  */
+  PROFILE_TYPENAME_HITS,
+  PROFILE_TYPENAME_MISSES,      /* Type names actually computed.  */
+  PROFILE_INDEX_CACHE_HITS,
+  PROFILE_INDEX_CACHE_MISSES,
+  PROFILE_N_COUNTERS
+} ProfileCounter;
+
+
+G_GNUC_INTERNAL
+extern gboolean profile_enabled;
+
+/* Counting costs only this test while profiling is off.  */
+#define PROFILE_COUNT(counter, n)                       \
+  G_STMT_START {                                        \
+    if (G_UNLIKELY (profile_enabled))                   \
+      profile_add ((counter), (n));                     \
+  } G_STMT_END
+
+G_GNUC_INTERNAL
+void profile_start (const char *trace_file);
+
+G_GNUC_INTERNAL
+gint64 profile_begin (void);
+
+G_GNUC_INTERNAL
+void profile_end (gint64 start, const char *name);
+
+G_GNUC_INTERNAL
+void profile_add (ProfileCounter counter, guint64 n);
+
+G_GNUC_INTERNAL
+gboolean profile_finish (void);
+
+
+#endif /* _PROFILE_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
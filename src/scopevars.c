@@ -0,0 +1,172 @@
+/*
+ * Live variable implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <dwarf.h>
+#include "scopevars.h"
+#include "addrtable.h"
+#include "profile.h"
+
+
+/* The first time a function is asked about, each variable and parameter
+ * in it, including those of its blocks and inlined calls, becomes ranges
+ * in an interval table: the entries of its location list, or the whole of
+ * its scope for a single location or a constant.  Then the variables live
+ * at any address are just those ranges which have it.  */
+
+
+static void
+scope_vars_table_free (gpointer data)
+{
+  addr_table_clear (data);
+  g_slice_free (AddrTable, data);
+}
+
+
+static void
+scope_vars_add_var (AddrTable *table, Dwarf_Die *scope, Dwarf_Die *var)
+{
+  Dwarf_Off offset = dwarf_dieoffset (var);
+  Dwarf_Attribute attr;
+  if (dwarf_attr (var, DW_AT_location, &attr) == NULL)
+    {
+      if (dwarf_attr (var, DW_AT_const_value, &attr) != NULL)
+        addr_table_add_die (table, scope, offset);
+      return;
+    }
+
+  Dwarf_Addr base, start, end;
+  Dwarf_Op *ops;
+  size_t nops;
+  ptrdiff_t next = 0;
+  while ((next = dwarf_getlocations (&attr, next, &base, &start, &end,
+                                     &ops, &nops)) > 0)
+    {
+      /* An empty expression means it's optimized out there.  */
+      if (nops == 0)
+        continue;
+      if (start == 0 && end == (Dwarf_Addr) -1)
+        addr_table_add_die (table, scope, offset);
+      else
+        addr_table_add (table, start, end, offset);
+    }
+}
+
+
+static void
+scope_vars_add (AddrTable *table, Dwarf_Die *scope)
+{
+  Dwarf_Die child;
+  if (dwarf_child (scope, &child) == 0)
+    do
+      switch (dwarf_tag (&child))
+        {
+        case DW_TAG_variable:
+        case DW_TAG_formal_parameter:
+          scope_vars_add_var (table, scope, &child);
+          break;
+
+        case DW_TAG_lexical_block:
+        case DW_TAG_inlined_subroutine:
+          scope_vars_add (table, &child);
+          break;
+        }
+    while (dwarf_siblingof (&child, &child) == 0);
+}
+
+
+/* Find the outermost function containing an address in a DIE's unit.  */
+gboolean
+scope_vars_function (Dwarf_Die *die, Dwarf_Addr pc, Dwarf_Die *function)
+{
+  Dwarf_Die cudie, *scopes;
+  if (dwarf_diecu (die, &cudie, NULL, NULL) == NULL)
+    return FALSE;
+
+  int n = dwarf_getscopes (&cudie, pc, &scopes);
+  gboolean found = FALSE;
+  for (int i = n - 1; i >= 0 && !found; --i)
+    if (dwarf_tag (&scopes[i]) == DW_TAG_subprogram)
+      {
+        *function = scopes[i];
+        found = TRUE;
+      }
+
+  if (n > 0)
+    free (scopes);
+  return found;
+}
+
+
+static int
+scope_vars_compare (const void *a, const void *b)
+{
+  const Dwarf_Off *oa = a, *ob = b;
+  return (*oa > *ob) - (*oa < *ob);
+}
+
+
+/* Append the Dwarf_Die of every variable and parameter of a function
+ * which has a location at the address, in the order they're declared.
+ * Each function's table is built once and kept with the session.  */
+void
+scope_vars_live (DwarvishSession *session, Dwarf_Die *function,
+                 Dwarf_Addr pc, GArray *vars)
+{
+  if (session->scope_vars == NULL)
+    session->scope_vars = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal, NULL,
+                                                 scope_vars_table_free);
+
+  AddrTable *table = g_hash_table_lookup (session->scope_vars,
+                                          function->addr);
+  if (table == NULL)
+    {
+      gint64 start = profile_begin ();
+      table = g_slice_new (AddrTable);
+      addr_table_init (table);
+      scope_vars_add (table, function);
+      addr_table_sort (table);
+      g_hash_table_insert (session->scope_vars, function->addr, table);
+      profile_end (start, "scope variables");
+    }
+
+  GArray *offsets = g_array_new (FALSE, FALSE, sizeof (Dwarf_Off));
+  addr_table_find_all (table, pc, offsets);
+  qsort (offsets->data, offsets->len, sizeof (Dwarf_Off),
+         scope_vars_compare);
+
+  Dwarf *dwarf = dwarf_cu_getdwarf (function->cu);
+  for (guint i = 0; i < offsets->len; ++i)
+    {
+      /* A variable might have several entries with the address.  */
+      Dwarf_Off offset = g_array_index (offsets, Dwarf_Off, i);
+      Dwarf_Die var;
+      if ((i == 0 || offset != g_array_index (offsets, Dwarf_Off, i - 1))
+          && dwarf_offdie (dwarf, offset, &var) != NULL)
+        g_array_append_val (vars, var);
+    }
+  g_array_free (offsets, TRUE);
+}
+
+
+void
+scope_vars_free (DwarvishSession *session)
+{
+  if (session->scope_vars != NULL)
+    g_hash_table_destroy (session->scope_vars);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
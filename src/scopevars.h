@@ -0,0 +1,38 @@
+/*
+ * Live variable interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _SCOPEVARS_H_
+#define _SCOPEVARS_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+G_GNUC_INTERNAL
+gboolean scope_vars_function (Dwarf_Die *die,
+                              Dwarf_Addr pc,
+                              Dwarf_Die *function);
+
+G_GNUC_INTERNAL
+void scope_vars_live (DwarvishSession *session,
+                      Dwarf_Die *function,
+                      Dwarf_Addr pc,
+                      GArray *vars);
+
+G_GNUC_INTERNAL
+void scope_vars_free (DwarvishSession *session);
+
+
+#endif /* _SCOPEVARS_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,232 @@
+/*
+ * Common session object
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE 1
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "session.h"
+#include "addrindex.h"
+#include "cuinfo.h"
+#include "dieindex.h"
+#include "indexcache.h"
+#include "linetable.h"
+#include "loaddwfl.h"
+#include "nameindex.h"
+#include "profile.h"
+#include "scopevars.h"
+#include "sigindex.h"
+#include "splitunit.h"
+#include "typename.h"
+
+
+DwarvishSession *
+session_begin (void)
+{
+  return g_malloc0 (sizeof (DwarvishSession));
+}
+
+
+/* Open the DWARF of the session's module, and the metadata about it.  */
+static const char *
+session_init_module (DwarvishSession *session)
+{
+  /* This is where the debug file is found, and decompressed if need be.  */
+  gint64 start = profile_begin ();
+  Dwarf_Addr bias;
+  session->dwarf = dwfl_module_getdwarf (session->dwflmod, &bias);
+  profile_end (start, "getdwarf");
+  if (session->dwarf == NULL)
+    return "No DWARF found for the target.";
+
+  const char *mainfile, *debugfile;
+  const char *modname = dwfl_module_info (session->dwflmod,
+                                          NULL, NULL, NULL, NULL, NULL,
+                                          &mainfile, &debugfile);
+  session->basename = g_path_get_basename (modname);
+  session->mainfile = canonicalize_file_name (mainfile);
+  session->debugfile = canonicalize_file_name (debugfile);
+
+  /* Find the alt file now, so clones on other threads only read it.  */
+  session->altdwarf = dwarf_getalt (session->dwarf);
+
+  const char *debugaltfile = get_debugaltfile (session->dwarf);
+  if (debugaltfile != NULL)
+    {
+      if (g_path_is_absolute (debugaltfile))
+        session->debugaltfile = canonicalize_file_name (debugaltfile);
+      else
+        {
+          /* If not absolute, the path is relative the file with the Dwarf.  */
+          const char *file = session->debugfile ?: session->mainfile;
+          gchar *dirname = g_path_get_dirname (file);
+          gchar *altfile = g_build_filename (dirname, debugaltfile, NULL);
+          session->debugaltfile = canonicalize_file_name (altfile);
+          g_free (dirname);
+          g_free (altfile);
+        }
+    }
+
+  start = profile_begin ();
+  index_cache_init (session);
+  profile_end (start, "index cache init");
+  return NULL;
+}
+
+
+/* Load the target named by the session options, returning an error
+ * message on failure.  A list of kernel modules is only reported, and
+ * each module's DWARF is opened later by session_open_module.  */
+const char *
+session_init_dwarf (DwarvishSession *session)
+{
+  const char *modules[] = { session->module ?: "kernel", NULL };
+  gint64 start = profile_begin ();
+  session->dwfl = session->file ? load_elf_dwfl (session->file)
+    : load_kernel_dwfl (session->kernel, modules, session->modules);
+  session->dwflmod = get_first_module (session->dwfl);
+  profile_end (start, "load dwfl");
+
+  if (session->dwflmod == NULL)
+    return "Couldn't load the requested target.";
+
+  if (session->modules != NULL)
+    {
+      session->dwflmod = NULL;
+      session->basename = g_strdup (session->kernel ?: "kernel");
+      return NULL;
+    }
+
+  return session_init_module (session);
+}
+
+
+/* Open one module of a session listing kernel modules.  The new session
+ * shares the list's Dwfl, and is ended along with the list.  */
+DwarvishSession *
+session_open_module (DwarvishSession *session, Dwfl_Module *dwflmod,
+                     const char **error)
+{
+  DwarvishSession *module = session_begin ();
+  module->nested_imports = session->nested_imports;
+  module->explicit_imports = session->explicit_imports;
+  module->explicit_siblings = session->explicit_siblings;
+  module->attr_depth = session->attr_depth;
+  module->kernel = g_strdup (session->kernel);
+  module->module = g_strdup (dwfl_module_info (dwflmod, NULL, NULL, NULL,
+                                               NULL, NULL, NULL, NULL));
+
+  module->dwfl = session->dwfl;
+  module->borrowed_dwfl = TRUE;
+  module->dwflmod = dwflmod;
+
+  if (session->module_sessions == NULL)
+    session->module_sessions =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) session_end);
+  g_ptr_array_add (session->module_sessions, module);
+
+  *error = session_init_module (module);
+  return *error == NULL ? module : NULL;
+}
+
+
+static Dwarf *
+session_dwarf_begin (Dwarf *dwarf)
+{
+  return dwarf_begin_elf (dwarf_getelf (dwarf), DWARF_C_READ, NULL);
+}
+
+
+/* Begin a session with the same options and its own libdw handles and
+ * caches, for a thread to read DIEs while others do.  The handles share
+ * the session's Elf, whose sections were already found, decompressed and
+ * relocated, so that's all done once, and strings read through a clone
+ * stay valid after it's ended.  Clones have no Dwfl or index caches, and
+ * may be begun on the thread which uses them.  */
+DwarvishSession *
+session_clone (DwarvishSession *session, const char **error)
+{
+  DwarvishSession *clone = session_begin ();
+  clone->nested_imports = session->nested_imports;
+  clone->explicit_imports = session->explicit_imports;
+  clone->explicit_siblings = session->explicit_siblings;
+  clone->attr_depth = session->attr_depth;
+  clone->kernel = g_strdup (session->kernel);
+  clone->module = g_strdup (session->module);
+  clone->file = g_strdup (session->file);
+  clone->basename = g_strdup (session->basename);
+  clone->mainfile = session->mainfile ? strdup (session->mainfile) : NULL;
+  clone->debugfile = session->debugfile ? strdup (session->debugfile) : NULL;
+  clone->cloned = TRUE;
+
+  clone->dwarf = session_dwarf_begin (session->dwarf);
+  if (clone->dwarf != NULL && session->altdwarf != NULL)
+    {
+      clone->altdwarf = session_dwarf_begin (session->altdwarf);
+      if (clone->altdwarf != NULL)
+        dwarf_setalt (clone->dwarf, clone->altdwarf);
+    }
+
+  if (clone->dwarf == NULL
+      || (session->altdwarf != NULL && clone->altdwarf == NULL))
+    {
+      *error = "Couldn't open the target's DWARF again.";
+      session_end (clone);
+      return NULL;
+    }
+  *error = NULL;
+  return clone;
+}
+
+
+void
+session_end (DwarvishSession *session)
+{
+  g_free (session->kernel);
+  g_free (session->module);
+  g_free (session->modules);
+  g_free (session->file);
+
+  if (session->module_sessions != NULL)
+    g_ptr_array_free (session->module_sessions, TRUE);
+
+  addr_index_free (session);
+  sig_index_free (session);
+  name_index_free (session);
+  cu_info_free (session);
+  line_table_free (session);
+  scope_vars_free (session);
+  die_index_free (session);
+  die_typename_free (session);
+  index_cache_free (session);
+  split_unit_free (session);
+  if (session->cloned)
+    {
+      dwarf_end (session->dwarf);
+      dwarf_end (session->altdwarf);
+    }
+  if (!session->borrowed_dwfl)
+    dwfl_end (session->dwfl);
+
+  g_free (session->basename);
+  free (session->mainfile);
+  free (session->debugfile);
+  free (session->debugaltfile);
+
+  g_free (session);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -21,23 +21,85 @@ typedef struct _DwarvishSession
   gboolean nested_imports;
   gboolean explicit_imports;
   gboolean explicit_siblings;
+  gint attr_depth;
   gchar *kernel;
   gchar *module;
+  gchar *modules;       /* A glob of kernel modules to list.  */
   gchar *file;
 
   /* Elfutils objects.  */
   Dwfl *dwfl;
   Dwfl_Module *dwflmod;
   Dwarf *dwarf;
+  Dwarf *altdwarf;      /* The dwz alt file's, if any.  */
+  gboolean borrowed_dwfl;       /* Owned by the session listing modules.  */
+  gboolean cloned;      /* The Dwarf handles are its own, see session_clone.  */
+
+  /* Sessions of the modules opened from a list, see session.c.  */
+  GPtrArray *module_sessions;
 
   /* Additional metadata.  */
   gchar *basename;
   gchar *mainfile;
   gchar *debugfile;
   gchar *debugaltfile;
+
+  /* Lazily built indexes, see dieindex.c.  */
+  GHashTable *die_parents;
+  GHashTable *die_importers;
+
+  /* Unit metadata, see cuinfo.c.  */
+  GHashTable *cu_infos;
+
+  /* Decoded line programs, see linetable.c.  */
+  GHashTable *line_tables;
+
+  /* Variable location ranges of functions, see scopevars.c.  */
+  GHashTable *scope_vars;
+
+  /* Rendered type names, see typename.c.  */
+  GHashTable *typenames;
+  GHashTable *typename_parts;
+  gsize typename_bytes;
+  guint typename_hits;
+  guint typename_misses;
+
+  /* Name indexes for .debug_info and .debug_types, see nameindex.c.  */
+  struct _NameIndex *name_indexes[2];
+
+  /* On-disk caches of the same, see indexcache.c.  */
+  struct _IndexCache *index_caches[2];
+
+  /* Address ranges of units and functions, see addrindex.c.  */
+  struct _AddrIndex *addr_index;
+
+  /* Type units by signature, see sigindex.c.  */
+  struct _SigIndex *sig_index;
+
+  /* Split units shown in die trees, see splitunit.c.  */
+  struct _SplitUnits *split_units;
 } DwarvishSession;
 
 
+G_GNUC_INTERNAL
+DwarvishSession *session_begin (void);
+
+G_GNUC_INTERNAL
+const char *session_init_dwarf (DwarvishSession *session);
+
+G_GNUC_INTERNAL
+DwarvishSession *session_clone (DwarvishSession *session,
+                                const char **error);
+
+G_GNUC_INTERNAL
+DwarvishSession *session_open_module (DwarvishSession *session,
+                                      Dwfl_Module *dwflmod,
+                                      const char **error);
+
+G_GNUC_INTERNAL
+void session_end (DwarvishSession *session);
+
+
 #endif /* __SESSION_H__ */
 
 
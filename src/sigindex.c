@@ -0,0 +1,220 @@
+/*
+ * Type signature index implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <dwarf.h>
+#include "sigindex.h"
+#include "indexcache.h"
+#include "profile.h"
+
+
+/* DW_FORM_ref_sig8 names a type unit by its signature, so the type DIE of
+ * each type unit is kept by signature.  Those are in .debug_types before
+ * DWARF 5, and in .debug_info after, so each view adds the units its own
+ * scan finds, and a lookup which misses before both are done just scans
+ * the unit headers itself.  */
+typedef struct _SigType
+{
+  Dwarf_Off offset;     /* Of the type DIE.  */
+  gboolean types;       /* It's in .debug_types.  */
+} SigType;
+
+typedef struct _SigIndex
+{
+  GHashTable *types;    /* Type signature -> SigType.  */
+  gboolean complete[2]; /* Every type unit of the section has been added.  */
+} SigIndex;
+
+
+static void
+sig_type_free (gpointer data)
+{
+  g_slice_free (SigType, data);
+}
+
+
+static SigIndex *
+sig_index_get (DwarvishSession *session)
+{
+  SigIndex *index = session->sig_index;
+  if (index == NULL)
+    {
+      index = g_slice_new0 (SigIndex);
+      index->types = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                            g_free, sig_type_free);
+      session->sig_index = index;
+    }
+  return index;
+}
+
+
+void
+sig_index_add (DwarvishSession *session, guint64 signature,
+               Dwarf_Off offset, gboolean types)
+{
+  SigIndex *index = sig_index_get (session);
+  SigType *type = g_slice_new (SigType);
+  type->offset = offset;
+  type->types = !!types;
+  g_hash_table_insert (index->types, g_memdup (&signature, sizeof signature),
+                       type);
+}
+
+
+#ifdef HAVE_DWARF_CU_INFO
+/* Add a DWARF 5 type unit.  The type DIE is only asked for once it's known
+ * to be one, since for a skeleton libdw would go and open its split unit.  */
+static void
+sig_index_add_cu (DwarvishSession *session, Dwarf_CU *cu)
+{
+  Dwarf_Half version;
+  uint8_t unit_type;
+  uint64_t signature;
+  Dwarf_Die type;
+  if (dwarf_cu_info (cu, &version, &unit_type, NULL, NULL, &signature,
+                     NULL, NULL) == 0
+      && version >= 5 && unit_type == DW_UT_type
+      && dwarf_cu_info (cu, NULL, NULL, NULL, &type, NULL, NULL, NULL) == 0)
+    sig_index_add (session, signature, dwarf_dieoffset (&type), FALSE);
+}
+
+
+/* Add a unit of .debug_info, if it's a type unit.  */
+void
+sig_index_add_unit (DwarvishSession *session, Dwarf_Die *unit)
+{
+  sig_index_add_cu (session, unit->cu);
+}
+#else
+void
+sig_index_add_unit (G_GNUC_UNUSED DwarvishSession *session,
+                    G_GNUC_UNUSED Dwarf_Die *unit)
+{
+}
+#endif
+
+
+void
+sig_index_set_complete (DwarvishSession *session, gboolean types)
+{
+  sig_index_get (session)->complete[!!types] = TRUE;
+}
+
+
+/* Add every type unit that isn't yet, from the index cache if there is
+ * one.  Libdw only knows DWARF 5 type units from 0.171.  */
+static void
+sig_index_scan (DwarvishSession *session)
+{
+  SigIndex *index = sig_index_get (session);
+  gint64 start = profile_begin ();
+
+  if (!index->complete[TRUE])
+    {
+      gsize n_cached;
+      const IndexCacheUnit *cached =
+        index_cache_section (session->index_caches[TRUE], INDEX_CACHE_UNITS,
+                             &n_cached);
+      if (cached != NULL)
+        for (gsize i = 0; i < n_cached; ++i)
+          sig_index_add (session, cached[i].type_signature,
+                         cached[i].type_offset, TRUE);
+      else
+        {
+          uint64_t signature;
+          Dwarf_Off type_offset;
+          size_t cuhl;
+          for (Dwarf_Off noff, off = 0;
+               dwarf_next_unit (session->dwarf, off, &noff, &cuhl, NULL,
+                                NULL, NULL, NULL, &signature,
+                                &type_offset) == 0;
+               off = noff)
+            sig_index_add (session, signature, off + type_offset, TRUE);
+        }
+      sig_index_set_complete (session, TRUE);
+    }
+
+  if (!index->complete[FALSE])
+    {
+#ifdef HAVE_DWARF_CU_INFO
+      Dwarf_CU *cu = NULL;
+      while (dwarf_get_units (session->dwarf, cu, &cu, NULL, NULL,
+                              NULL, NULL) == 0)
+        sig_index_add_cu (session, cu);
+#endif
+      sig_index_set_complete (session, FALSE);
+    }
+
+  profile_end (start, "scan type signatures");
+}
+
+
+/* Read the signature of a DW_FORM_ref_sig8 attribute.  Libdw has no
+ * accessor for the form, but it's eight bytes just like data8, which
+ * libdw reads in the file's byte order.  */
+static gboolean
+sig_index_signature (Dwarf_Attribute *attr, guint64 *signature)
+{
+  Dwarf_Attribute data = *attr;
+  data.form = DW_FORM_data8;
+  Dwarf_Word word;
+  if (dwarf_formudata (&data, &word) != 0)
+    return FALSE;
+
+  *signature = word;
+  return TRUE;
+}
+
+
+/* Find the type DIE named by a DW_FORM_ref_sig8 attribute, and whether
+ * it's in .debug_types.  */
+gboolean
+sig_index_lookup (DwarvishSession *session, Dwarf_Attribute *attr,
+                  Dwarf_Die *type, gboolean *types)
+{
+  g_return_val_if_fail (dwarf_whatform (attr) == DW_FORM_ref_sig8, FALSE);
+
+  guint64 signature;
+  if (!sig_index_signature (attr, &signature))
+    return FALSE;
+
+  SigIndex *index = sig_index_get (session);
+  SigType *found = g_hash_table_lookup (index->types, &signature);
+  if (found == NULL && !(index->complete[FALSE] && index->complete[TRUE]))
+    {
+      sig_index_scan (session);
+      found = g_hash_table_lookup (index->types, &signature);
+    }
+  if (found == NULL)
+    return FALSE;
+
+  *types = found->types;
+  if (found->types)
+    return dwarf_offdie_types (session->dwarf, found->offset, type) != NULL;
+  return dwarf_offdie (session->dwarf, found->offset, type) != NULL;
+}
+
+
+void
+sig_index_free (DwarvishSession *session)
+{
+  SigIndex *index = session->sig_index;
+  if (index == NULL)
+    return;
+
+  g_hash_table_destroy (index->types);
+  g_slice_free (SigIndex, index);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
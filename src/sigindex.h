@@ -0,0 +1,47 @@
+/*
+ * Type signature index interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _SIGINDEX_H_
+#define _SIGINDEX_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+G_GNUC_INTERNAL
+void sig_index_add (DwarvishSession *session,
+                    guint64 signature,
+                    Dwarf_Off offset,
+                    gboolean types);
+
+G_GNUC_INTERNAL
+void sig_index_add_unit (DwarvishSession *session,
+                         Dwarf_Die *unit);
+
+G_GNUC_INTERNAL
+void sig_index_set_complete (DwarvishSession *session,
+                             gboolean types);
+
+G_GNUC_INTERNAL
+gboolean sig_index_lookup (DwarvishSession *session,
+                           Dwarf_Attribute *attr,
+                           Dwarf_Die *type,
+                           gboolean *types);
+
+G_GNUC_INTERNAL
+void sig_index_free (DwarvishSession *session);
+
+
+#endif /* _SIGINDEX_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
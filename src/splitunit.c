@@ -0,0 +1,223 @@
+/*
+ * Split DWARF unit implementation.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <dwarf.h>
+#include "splitunit.h"
+#include "profile.h"
+
+
+#ifdef HAVE_DWARF_CU_INFO
+
+/* With -gsplit-dwarf, the main file keeps only a skeleton of each unit,
+ * naming the .dwo file which has the rest, or the unit may be packed with
+ * the others in a .dwp next to the binary.  Libdw finds and opens these
+ * itself from 0.171, only when a skeleton's split unit is first asked
+ * for, and links the two so the split unit's address, range list and
+ * location list bases come from its skeleton.  The files stay open as
+ * long as the session's Dwarf.  Die trees have no Dwarf slot for each
+ * split unit, so their rows encode the unit's index here instead.  */
+typedef struct _SplitUnits
+{
+  GPtrArray *units;     /* Dwarf_CU of split units, by row index.  */
+  GHashTable *indexes;  /* Dwarf_CU -> index, plus one.  */
+} SplitUnits;
+
+
+static SplitUnits *
+split_units_get (DwarvishSession *session)
+{
+  SplitUnits *units = session->split_units;
+  if (units == NULL)
+    {
+      units = g_slice_new (SplitUnits);
+      units->units = g_ptr_array_new ();
+      units->indexes = g_hash_table_new (g_direct_hash, g_direct_equal);
+      session->split_units = units;
+    }
+  return units;
+}
+
+
+/* Get the other half of a skeleton or split unit of the given type.  The
+ * split unit of a skeleton is only asked for once it's known to be one,
+ * since that's what makes libdw look for its file.  */
+static gboolean
+split_unit_other (Dwarf_CU *cu, uint8_t type, Dwarf_Die *other)
+{
+  uint8_t unit_type;
+  return (dwarf_cu_info (cu, NULL, &unit_type, NULL, NULL, NULL,
+                         NULL, NULL) == 0
+          && unit_type == type
+          && dwarf_cu_info (cu, NULL, NULL, NULL, other, NULL,
+                            NULL, NULL) == 0
+          && other->addr != NULL);
+}
+
+
+/* Whether a DIE is in a split file, rather than the session's own.  */
+static gboolean
+split_unit_is_split (DwarvishSession *session, Dwarf_Die *die)
+{
+  Dwarf *dwarf = dwarf_cu_getdwarf (die->cu);
+  uint8_t unit_type;
+  return (dwarf != session->dwarf && dwarf != session->altdwarf
+          && dwarf_cu_info (die->cu, NULL, &unit_type, NULL, NULL, NULL,
+                            NULL, NULL) == 0
+          && unit_type == DW_UT_split_compile);
+}
+
+
+/* Get the name of a skeleton unit's split file, or NULL if it isn't one.
+ * DWARF 5 has its own tag and attribute for these, and GNU DWARF 4 used a
+ * plain compile unit with an extension.  */
+const char *
+split_unit_dwo_name (Dwarf_Die *die)
+{
+  Dwarf_Attribute attr;
+  int tag = dwarf_tag (die);
+  if (tag != DW_TAG_skeleton_unit && tag != DW_TAG_compile_unit)
+    return NULL;
+  return dwarf_formstring (dwarf_attr (die, DW_AT_dwo_name, &attr)
+                           ?: dwarf_attr (die, DW_AT_GNU_dwo_name, &attr));
+}
+
+
+/* Get the split unit DIE of a skeleton unit, which libdw looks for and
+ * opens the first time it's asked for.  */
+gboolean
+split_unit_get (G_GNUC_UNUSED DwarvishSession *session, Dwarf_Die *skeleton,
+                Dwarf_Die *unit)
+{
+  gint64 start = profile_begin ();
+  gboolean found = split_unit_other (skeleton->cu, DW_UT_skeleton, unit);
+  profile_end (start, "find split unit");
+  return found;
+}
+
+
+/* Get the index of the split unit holding a DIE, if it's from a split file.
+ * Units only reached by reference, not from a skeleton, get one too.  */
+gboolean
+split_unit_index (DwarvishSession *session, Dwarf_Die *die, guint *index)
+{
+  if (!split_unit_is_split (session, die))
+    return FALSE;
+
+  SplitUnits *units = split_units_get (session);
+  guint found = GPOINTER_TO_UINT (g_hash_table_lookup (units->indexes,
+                                                       die->cu));
+  if (found == 0)
+    {
+      g_ptr_array_add (units->units, die->cu);
+      found = units->units->len;
+      g_hash_table_insert (units->indexes, die->cu,
+                           GUINT_TO_POINTER (found));
+    }
+  *index = found - 1;
+  return TRUE;
+}
+
+
+/* Read a DIE of a split unit by its index.  */
+gboolean
+split_unit_offdie (DwarvishSession *session, guint index, Dwarf_Off offset,
+                   Dwarf_Die *die)
+{
+  SplitUnits *units = session->split_units;
+  g_return_val_if_fail (units != NULL && index < units->units->len, FALSE);
+
+  Dwarf_CU *cu = g_ptr_array_index (units->units, index);
+  return dwarf_offdie (dwarf_cu_getdwarf (cu), offset, die) != NULL;
+}
+
+
+/* Get the skeleton of the split unit holding a DIE.  */
+gboolean
+split_unit_skeleton (DwarvishSession *session, Dwarf_Die *die,
+                     Dwarf_Die *skeleton)
+{
+  return (split_unit_is_split (session, die)
+          && split_unit_other (die->cu, DW_UT_split_compile, skeleton));
+}
+
+
+void
+split_unit_free (DwarvishSession *session)
+{
+  SplitUnits *units = session->split_units;
+  if (units == NULL)
+    return;
+
+  g_hash_table_destroy (units->indexes);
+  g_ptr_array_free (units->units, TRUE);
+  g_slice_free (SplitUnits, units);
+}
+
+#else /* !HAVE_DWARF_CU_INFO */
+
+/* This libdw can't read split units, so skeletons are shown as they are.  */
+
+const char *
+split_unit_dwo_name (G_GNUC_UNUSED Dwarf_Die *die)
+{
+  return NULL;
+}
+
+
+gboolean
+split_unit_get (G_GNUC_UNUSED DwarvishSession *session,
+                G_GNUC_UNUSED Dwarf_Die *skeleton,
+                G_GNUC_UNUSED Dwarf_Die *unit)
+{
+  return FALSE;
+}
+
+
+gboolean
+split_unit_index (G_GNUC_UNUSED DwarvishSession *session,
+                  G_GNUC_UNUSED Dwarf_Die *die,
+                  G_GNUC_UNUSED guint *index)
+{
+  return FALSE;
+}
+
+
+gboolean
+split_unit_offdie (G_GNUC_UNUSED DwarvishSession *session,
+                   G_GNUC_UNUSED guint index,
+                   G_GNUC_UNUSED Dwarf_Off offset,
+                   G_GNUC_UNUSED Dwarf_Die *die)
+{
+  return FALSE;
+}
+
+
+gboolean
+split_unit_skeleton (G_GNUC_UNUSED DwarvishSession *session,
+                     G_GNUC_UNUSED Dwarf_Die *die,
+                     G_GNUC_UNUSED Dwarf_Die *skeleton)
+{
+  return FALSE;
+}
+
+
+void
+split_unit_free (G_GNUC_UNUSED DwarvishSession *session)
+{
+}
+
+#endif /* !HAVE_DWARF_CU_INFO */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,51 @@
+/*
+ * Split DWARF unit interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _SPLITUNIT_H_
+#define _SPLITUNIT_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+G_GNUC_INTERNAL
+const char *split_unit_dwo_name (Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+gboolean split_unit_get (DwarvishSession *session,
+                         Dwarf_Die *skeleton,
+                         Dwarf_Die *unit);
+
+G_GNUC_INTERNAL
+gboolean split_unit_index (DwarvishSession *session,
+                           Dwarf_Die *die,
+                           guint *index);
+
+G_GNUC_INTERNAL
+gboolean split_unit_offdie (DwarvishSession *session,
+                            guint index,
+                            Dwarf_Off offset,
+                            Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+gboolean split_unit_skeleton (DwarvishSession *session,
+                              Dwarf_Die *die,
+                              Dwarf_Die *skeleton);
+
+G_GNUC_INTERNAL
+void split_unit_free (DwarvishSession *session);
+
+
+#endif /* _SPLITUNIT_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
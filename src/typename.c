@@ -0,0 +1,308 @@
+/*
+ * C type name rendering.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <dwarf.h>
+#include "typename.h"
+#include "profile.h"
+
+
+/* The rendering of a referenced type, before any subroutine type it
+ * reached has been wrapped around it.  */
+typedef struct _TypenamePart
+{
+  gchar *string;        /* NULL if the type can't be named.  */
+  gsize len;
+  Dwarf_Die subroutine; /* The addr is NULL unless one was reached.  */
+} TypenamePart;
+
+
+static void
+typename_part_free (gpointer data)
+{
+  TypenamePart *part = data;
+  g_free (part->string);
+  g_slice_free (TypenamePart, part);
+}
+
+
+static GString *dwarf_die_typename_ref (DwarvishSession *session,
+                                        Dwarf_Die *die,
+                                        Dwarf_Die *subroutine);
+
+static GString *
+dwarf_die_typename_part (DwarvishSession *session, Dwarf_Die *die,
+                         Dwarf_Die *subroutine)
+{
+  const char *prepend = NULL, *append = NULL;
+  switch (dwarf_tag (die))
+    {
+    case DW_TAG_base_type:
+    case DW_TAG_typedef:
+      return g_string_new (dwarf_diename (die));
+
+    case DW_TAG_class_type:
+      prepend = "class ";
+      break;
+    case DW_TAG_enumeration_type:
+      prepend = "enum ";
+      break;
+    case DW_TAG_structure_type:
+      prepend = "struct ";
+      break;
+    case DW_TAG_union_type:
+      prepend = "union ";
+      break;
+
+    case DW_TAG_array_type:
+      append = "[]";
+      break;
+    case DW_TAG_const_type:
+      append = " const";
+      break;
+    case DW_TAG_pointer_type:
+      append = "*";
+      break;
+    case DW_TAG_reference_type:
+      append = "&";
+      break;
+    case DW_TAG_rvalue_reference_type:
+      append = "&&";
+      break;
+    case DW_TAG_volatile_type:
+      append = " volatile";
+      break;
+
+    case DW_TAG_subroutine_type:
+      /* Subroutine types (function pointers) are a weird case.  The modifiers
+       * we've recursed so far need to go in the middle, with the return type
+       * on the left and parameter types on the right.  We'll back out now to
+       * get those modifiers, getting the return and parameters separately.  */
+      *subroutine = *die;
+      return g_string_new ("");
+
+    default:
+      return NULL;
+    }
+
+  GString *string = NULL;
+  if (prepend != NULL)
+    {
+      GString *string = g_string_new (prepend);
+      return g_string_append (string, dwarf_diename (die) ?: "{...}");
+    }
+
+  Dwarf_Die type;
+  Dwarf_Attribute attr;
+  if (dwarf_attr (die, DW_AT_type, &attr) == NULL)
+    string = g_string_new ("void");
+  else if (dwarf_formref_die (&attr, &type) != NULL)
+    string = dwarf_die_typename_ref (session, &type, subroutine);
+
+  if (string == NULL)
+    return NULL;
+
+  if (append != NULL)
+    g_string_append (string, append);
+
+  return string;
+}
+
+
+/* Get the part of a name from a referenced type.  Chains of pointers,
+ * qualifiers and typedefs are shared by many types, so each link is also
+ * rendered once per session, keyed by its DIE's address like whole names,
+ * and counted in the same bytes to be trimmed along with them.  Returns a
+ * new string for the referrer to append to.  */
+static GString *
+dwarf_die_typename_ref (DwarvishSession *session, Dwarf_Die *die,
+                        Dwarf_Die *subroutine)
+{
+  if (session->typename_parts == NULL)
+    session->typename_parts = g_hash_table_new_full (g_direct_hash,
+                                                     g_direct_equal,
+                                                     NULL, typename_part_free);
+
+  TypenamePart *part = g_hash_table_lookup (session->typename_parts,
+                                            die->addr);
+  if (part == NULL)
+    {
+      part = g_slice_new0 (TypenamePart);
+      GString *string = dwarf_die_typename_part (session, die,
+                                                 &part->subroutine);
+      if (string != NULL)
+        {
+          part->len = string->len;
+          part->string = g_string_free (string, FALSE);
+          session->typename_bytes += part->len + 1;
+        }
+      g_hash_table_insert (session->typename_parts, die->addr, part);
+    }
+
+  if (part->subroutine.addr != NULL)
+    *subroutine = part->subroutine;
+  return part->string ? g_string_new_len (part->string, part->len) : NULL;
+}
+
+
+static GString *
+dwarf_die_typename (DwarvishSession *session, Dwarf_Die *die)
+{
+  Dwarf_Die subroutine;
+  subroutine.addr = 0;
+
+  GString *string = dwarf_die_typename_part (session, die, &subroutine);
+  if (string == NULL || subroutine.addr == 0)
+    return string;
+
+  /* Subroutine types need special handling.  First add the return value.  */
+  const char *retval;
+  Dwarf_Die type;
+  Dwarf_Attribute attr;
+  g_string_prepend (string, " (");
+  if (dwarf_attr (&subroutine, DW_AT_type, &attr) == NULL)
+    g_string_prepend (string, "void");
+  else if (dwarf_formref_die (&attr, &type) != NULL &&
+           (retval = die_typename (session, &type)) != NULL)
+    g_string_prepend (string, retval);
+  else
+    g_string_prepend (string, "?");
+  g_string_append (string, ")");
+
+  /* Now parameters.  */
+  gboolean first = TRUE;
+  g_string_append (string, " (");
+  Dwarf_Die child;
+  if (dwarf_child (&subroutine, &child) == 0)
+    do
+      if (dwarf_tag (&child) == DW_TAG_formal_parameter)
+        {
+          if (!first)
+            g_string_append (string, ", ");
+          else
+            first = FALSE;
+
+          const char *param;
+          if (dwarf_attr (&child, DW_AT_type, &attr) == NULL)
+            g_string_append (string, "void");
+          else if (dwarf_formref_die (&attr, &type) != NULL &&
+                   (param = die_typename (session, &type)) != NULL)
+            g_string_append (string, param);
+          else
+            g_string_append (string, "?");
+        }
+      else if (dwarf_tag (&child) == DW_TAG_unspecified_parameters)
+        {
+          if (!first)
+            g_string_append (string, ", ");
+          else
+            first = FALSE;
+          g_string_append (string, "...");
+        }
+    while (dwarf_siblingof (&child, &child) == 0);
+  if (first)
+    g_string_append (string, "void");
+  return g_string_append (string, ")");
+}
+
+
+/* Only these tags have a type name; anything else isn't worth caching.  */
+static gboolean
+dwarf_tag_has_typename (int tag)
+{
+  switch (tag)
+    {
+    case DW_TAG_base_type:
+    case DW_TAG_typedef:
+    case DW_TAG_class_type:
+    case DW_TAG_enumeration_type:
+    case DW_TAG_structure_type:
+    case DW_TAG_union_type:
+    case DW_TAG_array_type:
+    case DW_TAG_const_type:
+    case DW_TAG_pointer_type:
+    case DW_TAG_reference_type:
+    case DW_TAG_rvalue_reference_type:
+    case DW_TAG_volatile_type:
+    case DW_TAG_subroutine_type:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+
+/* Get the C name of a type DIE, computed once per session.  Entries are
+ * keyed by the DIE's address, which is unique across the main and alt
+ * files and .debug_types, unlike offsets.  The string is owned by the
+ * cache, and NULL is cached too for types that can't be named.  */
+const char *
+die_typename (DwarvishSession *session, Dwarf_Die *die)
+{
+  if (!dwarf_tag_has_typename (dwarf_tag (die)))
+    return NULL;
+
+  if (session->typenames == NULL)
+    session->typenames = g_hash_table_new_full (g_direct_hash,
+                                                g_direct_equal,
+                                                NULL, g_free);
+
+  gpointer name;
+  if (g_hash_table_lookup_extended (session->typenames, die->addr,
+                                    NULL, &name))
+    {
+      ++session->typename_hits;
+      PROFILE_COUNT (PROFILE_TYPENAME_HITS, 1);
+      return name;
+    }
+
+  ++session->typename_misses;
+  PROFILE_COUNT (PROFILE_TYPENAME_MISSES, 1);
+  GString *string = dwarf_die_typename (session, die);
+  name = NULL;
+  if (string != NULL)
+    {
+      session->typename_bytes += string->len + 1;
+      name = g_string_free (string, FALSE);
+    }
+  g_hash_table_insert (session->typenames, die->addr, name);
+  return name;
+}
+
+
+/* Forget every cached name once they add up to more than max_bytes, for
+ * callers which walk a whole file and can't let the cache grow with it.  */
+void
+die_typename_trim (DwarvishSession *session, gsize max_bytes)
+{
+  if (session->typenames != NULL && session->typename_bytes > max_bytes)
+    {
+      g_hash_table_remove_all (session->typenames);
+      if (session->typename_parts != NULL)
+        g_hash_table_remove_all (session->typename_parts);
+      session->typename_bytes = 0;
+    }
+}
+
+
+void
+die_typename_free (DwarvishSession *session)
+{
+  if (session->typenames != NULL)
+    g_hash_table_destroy (session->typenames);
+  if (session->typename_parts != NULL)
+    g_hash_table_destroy (session->typename_parts);
+}
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */
@@ -0,0 +1,35 @@
+/*
+ * C type name interface.
+ * Copyright (C) 2013  Josh Stone
+ *
+ * This file is part of dwarvish, and is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ */
+
+#ifndef _TYPENAME_H_
+#define _TYPENAME_H_
+
+#include <elfutils/libdw.h>
+#include <glib.h>
+
+#include "session.h"
+
+
+G_GNUC_INTERNAL
+const char *die_typename (DwarvishSession *session,
+                          Dwarf_Die *die);
+
+G_GNUC_INTERNAL
+void die_typename_trim (DwarvishSession *session,
+                        gsize max_bytes);
+
+G_GNUC_INTERNAL
+void die_typename_free (DwarvishSession *session);
+
+
+#endif /* _TYPENAME_H_ */
+
+
+/* vim: set sw=2 ts=8 cino=>4,n-2,{2,^-2,t0,(0,u0,w1,M1 : */